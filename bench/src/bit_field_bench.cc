@@ -0,0 +1,190 @@
+#include "bit_field.h"
+#include "bit_stream.h"
+#include "compact_vector.h"
+#include "elias_gamma_encoder.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <type_traits>
+#include <vector>
+#include <sys/time.h>
+
+typedef unsigned long long int TimeStamp;
+static TimeStamp GetTimestamp() {
+  struct timeval now{};
+  gettimeofday(&now, nullptr);
+
+  return now.tv_usec + (TimeStamp) now.tv_sec * 1000000;
+}
+
+#define NUM_FIELDS (16*1024*1024)
+#define NUM_CODES (16*1024*1024)
+#define NUM_GETS (16*1024*1024)
+#define GET_ARRAY_SIZE (256*1024)
+#define GET_WIDTH 23
+
+// Compares the table-based and BMI2 bit-field primitives on the loops that
+// use them: reading fields of varying widths, decoding Elias-gamma codes,
+// selecting within words and random single-field reads, as CompactVector::Get
+// does them. The single-field accessors use the BitField policy chosen at
+// compile time (see bit_field.h); build with -DBITS_USE_BMI2=ON to have
+// CompactVector::Get use BMI2.
+
+template<typename BitFieldImpl>
+static uint64_t SumFields(const std::vector<uint64_t> &words, const std::vector<uint8_t> &widths) {
+  uint64_t sum = 0;
+  size_t pos = 0;
+  for (size_t i = 0; i < widths.size(); i++) {
+    size_t idx = pos / 64, off = pos % 64;
+    uint64_t val = (off + widths[i] <= 64) ? BitFieldImpl::Extract(words[idx], off, widths[i])
+                                           : BitFieldImpl::LowBits((words[idx] >> off) | (words[idx + 1] << (64 - off)),
+                                                                   widths[i]);
+    sum += val;
+    pos += widths[i];
+  }
+  return sum;
+}
+
+template<typename BitFieldImpl>
+static uint64_t DecodeCodes(const bits::BitVector &codes, size_t num_codes) {
+  bits::BasicBitReader<BitFieldImpl> reader(codes);
+  uint64_t sum = 0;
+  for (size_t i = 0; i < num_codes; i++) {
+    sum += bits::EliasGammaEncoder<uint64_t>::Decode(reader);
+  }
+  return sum;
+}
+
+template<typename BitFieldImpl>
+static uint64_t SelectInWords(const std::vector<uint64_t> &words) {
+  uint64_t sum = 0;
+  for (size_t i = 0; i < words.size(); i++) {
+    sum += BitFieldImpl::SelectInWord(words[i] | 1, (uint8_t) (i % __builtin_popcountll(words[i] | 1)));
+  }
+  return sum;
+}
+
+// Random reads of GET_WIDTH-bit fields, in a vector that fits in the cache
+template<typename BitFieldImpl>
+static uint64_t GetFields(const bits::BitVector &vec) {
+  uint64_t sum = 0;
+  for (uint64_t i = 0; i < NUM_GETS; i++) {
+    uint64_t idx = (i * 2654435761ULL) % GET_ARRAY_SIZE;
+    sum += vec.GetValPosWith<BitFieldImpl>(idx * GET_WIDTH, GET_WIDTH);
+  }
+  return sum;
+}
+
+static uint64_t CompactVectorGets(const bits::CompactVector<uint64_t, GET_WIDTH> &vec) {
+  uint64_t sum = 0;
+  for (uint64_t i = 0; i < NUM_GETS; i++) {
+    sum += vec.Get((i * 2654435761ULL) % GET_ARRAY_SIZE);
+  }
+  return sum;
+}
+
+#ifdef BITS_X86
+BITS_TARGET("bmi,bmi2")
+static uint64_t BMI2SumFields(const std::vector<uint64_t> &words, const std::vector<uint8_t> &widths) {
+  return SumFields<bits::BMI2BitField>(words, widths);
+}
+
+BITS_TARGET("bmi,bmi2")
+static uint64_t BMI2DecodeCodes(const bits::BitVector &codes, size_t num_codes) {
+  return DecodeCodes<bits::BMI2BitField>(codes, num_codes);
+}
+
+BITS_TARGET("bmi,bmi2")
+static uint64_t BMI2SelectInWords(const std::vector<uint64_t> &words) {
+  return SelectInWords<bits::BMI2BitField>(words);
+}
+
+BITS_TARGET("bmi,bmi2")
+static uint64_t BMI2GetFields(const bits::BitVector &vec) {
+  return GetFields<bits::BMI2BitField>(vec);
+}
+#endif
+
+int main(int argc, char **argv) {
+  if (argc > 1) {
+    fprintf(stderr, "%s does not take any arguments.\n", argv[0]);
+  }
+
+  std::mt19937_64 gen(0);
+  std::vector<uint8_t> widths(NUM_FIELDS);
+  size_t total_bits = 0;
+  for (auto &width : widths) {
+    width = (uint8_t) (1 + gen() % 64);
+    total_bits += width;
+  }
+  std::vector<uint64_t> words(total_bits / 64 + 2);
+  for (auto &word : words) {
+    word = gen();
+  }
+
+  std::vector<uint64_t> values(NUM_CODES);
+  for (auto &val : values) {
+    val = 1 + (gen() % 1024);
+  }
+  bits::BitVector codes = bits::EliasGammaEncoder<uint64_t>::EncodeArray(values);
+
+  bits::CompactVector<uint64_t, GET_WIDTH> fields(GET_ARRAY_SIZE);
+  for (uint64_t i = 0; i < GET_ARRAY_SIZE; i++) {
+    fields[i] = gen() % (1ULL << GET_WIDTH);
+  }
+
+  bool has_bmi2 = bits::CpuInfo::HasBMI2();
+  fprintf(stderr, "BMI2 supported = %d; BitField = %s\n", has_bmi2,
+          std::is_same<bits::BitField, bits::TableBitField>::value ? "TableBitField" : "BMI2BitField");
+
+  TimeStamp t0 = GetTimestamp();
+  uint64_t sum = SumFields<bits::TableBitField>(words, widths);
+  TimeStamp t1 = GetTimestamp();
+  fprintf(stderr, "Time to read fields with tables = %llu; sum=%llu\n", (t1 - t0), (unsigned long long) sum);
+
+  t0 = GetTimestamp();
+  sum = DecodeCodes<bits::TableBitField>(codes, NUM_CODES);
+  t1 = GetTimestamp();
+  fprintf(stderr, "Time to decode gamma codes with tables = %llu; sum=%llu\n", (t1 - t0), (unsigned long long) sum);
+
+  t0 = GetTimestamp();
+  sum = SelectInWords<bits::TableBitField>(words);
+  t1 = GetTimestamp();
+  fprintf(stderr, "Time to select in words with broadword select = %llu; sum=%llu\n", (t1 - t0),
+          (unsigned long long) sum);
+
+  t0 = GetTimestamp();
+  sum = GetFields<bits::TableBitField>(fields);
+  t1 = GetTimestamp();
+  fprintf(stderr, "Time for random field reads with tables = %llu; sum=%llu\n", (t1 - t0), (unsigned long long) sum);
+
+  t0 = GetTimestamp();
+  sum = CompactVectorGets(fields);
+  t1 = GetTimestamp();
+  fprintf(stderr, "Time for random CompactVector::Get = %llu; sum=%llu\n", (t1 - t0), (unsigned long long) sum);
+
+#ifdef BITS_X86
+  if (has_bmi2) {
+    t0 = GetTimestamp();
+    sum = BMI2SumFields(words, widths);
+    t1 = GetTimestamp();
+    fprintf(stderr, "Time to read fields with BMI2 = %llu; sum=%llu\n", (t1 - t0), (unsigned long long) sum);
+
+    t0 = GetTimestamp();
+    sum = BMI2DecodeCodes(codes, NUM_CODES);
+    t1 = GetTimestamp();
+    fprintf(stderr, "Time to decode gamma codes with BMI2 = %llu; sum=%llu\n", (t1 - t0), (unsigned long long) sum);
+
+    t0 = GetTimestamp();
+    sum = BMI2SelectInWords(words);
+    t1 = GetTimestamp();
+    fprintf(stderr, "Time to select in words with PDEP = %llu; sum=%llu\n", (t1 - t0), (unsigned long long) sum);
+
+    t0 = GetTimestamp();
+    sum = BMI2GetFields(fields);
+    t1 = GetTimestamp();
+    fprintf(stderr, "Time for random field reads with BMI2 = %llu; sum=%llu\n", (t1 - t0), (unsigned long long) sum);
+  }
+#endif
+}
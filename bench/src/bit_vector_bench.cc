@@ -1,6 +1,7 @@
 #include "bit_vector.h"
 
 #include <cstdio>
+#include <fstream>
 #include <vector>
 #include <sys/time.h>
 
@@ -43,6 +44,90 @@ int main(int argc, char** argv) {
 
     fprintf(stderr, "Time to read BitVector = %llu; sum=%lld\n",
             (t1 - t0), sum);
+
+    {
+      std::ofstream out("bit_vector_bench.bin", std::ios::binary);
+      bitmap.Serialize(out);
+    }
+
+    bits::BitVector loaded;
+    t0 = GetTimestamp();
+    {
+      std::ifstream in("bit_vector_bench.bin", std::ios::binary);
+      loaded.Deserialize(in);
+    }
+    t1 = GetTimestamp();
+
+    fprintf(stderr, "Time to deserialize BitVector = %llu\n", (t1 - t0));
+
+    bits::BitVector mapped;
+    t0 = GetTimestamp();
+    mapped.MemoryMap("bit_vector_bench.bin");
+    t1 = GetTimestamp();
+
+    fprintf(stderr, "Time to memory map BitVector = %llu\n", (t1 - t0));
+    remove("bit_vector_bench.bin");
+
+    bits::BitVector other(BITMAP_SIZE), result(BITMAP_SIZE);
+    for (size_t i = 0; i < BITMAP_SIZE; i++) {
+      if (i % 3 == 0) {
+        other.SetBit(i);
+      }
+    }
+
+    t0 = GetTimestamp();
+    for (size_t i = 0; i < BITMAP_SIZE; i++) {
+      if (bitmap.GetBit(i) && other.GetBit(i)) {
+        result.SetBit(i);
+      }
+    }
+    t1 = GetTimestamp();
+
+    fprintf(stderr, "Time to AND BitVectors bit-by-bit = %llu\n", (t1 - t0));
+
+    t0 = GetTimestamp();
+    bits::BitVector::And(result, bitmap, other);
+    t1 = GetTimestamp();
+
+    fprintf(stderr, "Time to AND BitVectors in bulk = %llu\n", (t1 - t0));
+
+    bits::BitVector sparse(BITMAP_SIZE);
+    for (size_t i = 0; i < BITMAP_SIZE; i += 257) {
+      sparse.SetBit(i);
+    }
+
+    sum = 0;
+    t0 = GetTimestamp();
+    for (size_t i = 0; i < BITMAP_SIZE; i++) {
+      if (sparse.GetBit(i)) {
+        sum += i;
+      }
+    }
+    t1 = GetTimestamp();
+
+    fprintf(stderr, "Time to enumerate sparse BitVector with GetBit = %llu; sum=%lld\n", (t1 - t0), sum);
+
+    sum = 0;
+    t0 = GetTimestamp();
+    sparse.ForEachSetBit([&sum](size_t i) { sum += i; });
+    t1 = GetTimestamp();
+
+    fprintf(stderr, "Time to enumerate sparse BitVector with ForEachSetBit = %llu; sum=%lld\n", (t1 - t0), sum);
+
+    sum = 0;
+    t0 = GetTimestamp();
+    for (size_t i = 0; i < BITMAP_SIZE / 64; i++) {
+      sum += bits::Utils::Popcount64bit(bitmap.GetData()[i]);
+    }
+    t1 = GetTimestamp();
+
+    fprintf(stderr, "Time to count BitVector word-by-word = %llu; sum=%lld\n", (t1 - t0), sum);
+
+    t0 = GetTimestamp();
+    sum = bitmap.Count();
+    t1 = GetTimestamp();
+
+    fprintf(stderr, "Time to count BitVector with Count = %llu; sum=%lld\n", (t1 - t0), sum);
   }
   {
     std::vector<bool> bitmap(BITMAP_SIZE, 0);
@@ -1,6 +1,16 @@
+#include "atomic_compact_vector.h"
 #include "compact_vector.h"
+#include "dynamic_compact_vector.h"
+#include "pfor_vector.h"
+#include "radix_sort.h"
 
+#include <algorithm>
+#include <atomic>
 #include <cstdio>
+#include <fstream>
+#include <random>
+#include <thread>
+#include <vector>
 #include <sys/time.h>
 
 typedef unsigned long long int TimeStamp;
@@ -12,6 +22,309 @@ static TimeStamp GetTimestamp() {
 }
 
 #define ARRAY_SIZE (100*1024*1024)
+#define NUM_RANDOM_READS (10*1024*1024)
+#define RANGE_ARRAY_SIZE (16*1024*1024)
+#define RANGE_CHUNK_SIZE 4096
+
+static void BenchRandomGet(const char *name, bits::Allocator *allocator) {
+  bits::CompactVector<uint64_t, 30> v(ARRAY_SIZE, allocator);
+  for (size_t i = 0; i < ARRAY_SIZE; i++) {
+    v.Set(i, i);
+  }
+
+  std::mt19937_64 gen(0);
+  std::vector<uint64_t> idx(NUM_RANDOM_READS);
+  for (auto &i : idx) {
+    i = gen() % ARRAY_SIZE;
+  }
+
+  uint64_t sum = 0;
+  TimeStamp t0 = GetTimestamp();
+  for (size_t i = 0; i < NUM_RANDOM_READS; i++) {
+    sum += v.Get(idx[i]);
+  }
+  TimeStamp t1 = GetTimestamp();
+
+  fprintf(stderr, "Time for random reads on %s CompactVector = %llu; sum=%llu\n", name, (t1 - t0),
+          (unsigned long long) sum);
+
+  std::vector<uint64_t> out(NUM_RANDOM_READS);
+  t0 = GetTimestamp();
+  v.MultiGet(&idx[0], NUM_RANDOM_READS, &out[0]);
+  t1 = GetTimestamp();
+  sum = 0;
+  for (auto val : out) {
+    sum += val;
+  }
+  fprintf(stderr, "Time for MultiGet on %s CompactVector = %llu; sum=%llu\n", name, (t1 - t0),
+          (unsigned long long) sum);
+
+  t0 = GetTimestamp();
+  v.MultiGet(&idx[0], NUM_RANDOM_READS, &out[0], true);
+  t1 = GetTimestamp();
+  sum = 0;
+  for (auto val : out) {
+    sum += val;
+  }
+  fprintf(stderr, "Time for grouped MultiGet on %s CompactVector = %llu; sum=%llu\n", name, (t1 - t0),
+          (unsigned long long) sum);
+}
+
+template<uint8_t W>
+static void BenchRangeOps() {
+  std::vector<uint64_t> values(RANGE_ARRAY_SIZE);
+  for (size_t i = 0; i < RANGE_ARRAY_SIZE; i++) {
+    values[i] = (i * 0x9E3779B97F4A7C15ULL) & low_bits_set[W];
+  }
+
+  TimeStamp t0 = GetTimestamp();
+  bits::CompactVector<uint64_t, W> set(RANGE_ARRAY_SIZE);
+  for (size_t i = 0; i < RANGE_ARRAY_SIZE; i++) {
+    set.Set(i, values[i]);
+  }
+  TimeStamp t1 = GetTimestamp();
+  fprintf(stderr, "Time to fill %u-bit CompactVector with Set = %llu\n", W, (t1 - t0));
+
+  t0 = GetTimestamp();
+  bits::CompactVector<uint64_t, W> v(&values[0], RANGE_ARRAY_SIZE);
+  t1 = GetTimestamp();
+  fprintf(stderr, "Time to fill %u-bit CompactVector with SetRange = %llu\n", W, (t1 - t0));
+
+  uint64_t sum = 0;
+  t0 = GetTimestamp();
+  for (size_t i = 0; i < RANGE_ARRAY_SIZE; i++) {
+    sum += v.Get(i);
+  }
+  t1 = GetTimestamp();
+  fprintf(stderr, "Time to read %u-bit CompactVector with Get = %llu; sum=%llu\n", W, (t1 - t0),
+          (unsigned long long) sum);
+
+  std::vector<uint64_t> chunk(RANGE_CHUNK_SIZE);
+  sum = 0;
+  t0 = GetTimestamp();
+  for (size_t i = 0; i < RANGE_ARRAY_SIZE; i += RANGE_CHUNK_SIZE) {
+    v.GetRange(i, RANGE_CHUNK_SIZE, &chunk[0]);
+    for (size_t j = 0; j < RANGE_CHUNK_SIZE; j++) {
+      sum += chunk[j];
+    }
+  }
+  t1 = GetTimestamp();
+  fprintf(stderr, "Time to read %u-bit CompactVector with GetRange = %llu; sum=%llu\n", W, (t1 - t0),
+          (unsigned long long) sum);
+}
+
+// Byte-aligned widths are stored as native arrays
+static void BenchByteAligned() {
+  TimeStamp t0 = GetTimestamp();
+  bits::CompactVector<uint32_t, 32> v(RANGE_ARRAY_SIZE);
+  for (size_t i = 0; i < RANGE_ARRAY_SIZE; i++) {
+    v.Set(i, (uint32_t) i);
+  }
+  TimeStamp t1 = GetTimestamp();
+  fprintf(stderr, "Time to fill 32-bit CompactVector with Set = %llu\n", (t1 - t0));
+
+  uint64_t sum = 0;
+  t0 = GetTimestamp();
+  for (size_t i = 0; i < RANGE_ARRAY_SIZE; i++) {
+    sum += v.Get(i);
+  }
+  t1 = GetTimestamp();
+  fprintf(stderr, "Time to read 32-bit CompactVector with Get = %llu; sum=%llu\n", (t1 - t0),
+          (unsigned long long) sum);
+
+  t0 = GetTimestamp();
+  std::vector<uint32_t> array(RANGE_ARRAY_SIZE);
+  for (size_t i = 0; i < RANGE_ARRAY_SIZE; i++) {
+    array[i] = (uint32_t) i;
+  }
+  t1 = GetTimestamp();
+  fprintf(stderr, "Time to fill std::vector<uint32_t> = %llu\n", (t1 - t0));
+
+  sum = 0;
+  t0 = GetTimestamp();
+  for (size_t i = 0; i < RANGE_ARRAY_SIZE; i++) {
+    sum += array[i];
+  }
+  t1 = GetTimestamp();
+  fprintf(stderr, "Time to read std::vector<uint32_t> = %llu; sum=%llu\n", (t1 - t0), (unsigned long long) sum);
+}
+
+static void BenchDynamic() {
+  TimeStamp t0 = GetTimestamp();
+  bits::DynamicCompactVector<uint64_t> v;
+  for (size_t i = 0; i < RANGE_ARRAY_SIZE; i++) {
+    v.Append(i);
+  }
+  TimeStamp t1 = GetTimestamp();
+  fprintf(stderr, "Time to fill DynamicCompactVector (%u bits) = %llu\n", v.GetBitWidth(), (t1 - t0));
+
+  std::vector<uint64_t> chunk(RANGE_CHUNK_SIZE);
+  uint64_t sum = 0;
+  t0 = GetTimestamp();
+  for (size_t i = 0; i < RANGE_ARRAY_SIZE; i += RANGE_CHUNK_SIZE) {
+    v.GetRange(i, RANGE_CHUNK_SIZE, &chunk[0]);
+    for (size_t j = 0; j < RANGE_CHUNK_SIZE; j++) {
+      sum += chunk[j];
+    }
+  }
+  t1 = GetTimestamp();
+  fprintf(stderr, "Time to read DynamicCompactVector with GetRange = %llu; sum=%llu\n", (t1 - t0),
+          (unsigned long long) sum);
+}
+
+// Timestamp-like column: locally narrow, globally wide, with rare outliers
+static void BenchPFor() {
+  std::vector<uint64_t> values(RANGE_ARRAY_SIZE);
+  std::mt19937_64 gen(0);
+  for (size_t i = 0; i < RANGE_ARRAY_SIZE; i++) {
+    values[i] = (1ULL << 40) + i * 1000 + gen() % 1024;
+    if (gen() % 100 == 0)
+      values[i] += gen() % (1ULL << 32);
+  }
+
+  std::ofstream null_out("/dev/null");
+  bits::CompactVector<uint64_t, 64> plain(&values[0], RANGE_ARRAY_SIZE);
+  bits::DynamicCompactVector<uint64_t> dynamic(&values[0], RANGE_ARRAY_SIZE);
+  TimeStamp t0 = GetTimestamp();
+  bits::PForVector<uint64_t> pfor(&values[0], RANGE_ARRAY_SIZE);
+  TimeStamp t1 = GetTimestamp();
+  fprintf(stderr, "Time to encode PForVector = %llu\n", (t1 - t0));
+  fprintf(stderr, "Size of 64-bit CompactVector = %zu, %u-bit DynamicCompactVector = %zu, PForVector = %zu\n",
+          plain.Serialize(null_out), dynamic.GetBitWidth(), dynamic.Serialize(null_out), pfor.Serialize(null_out));
+
+  std::vector<uint64_t> chunk(RANGE_CHUNK_SIZE);
+  const bits::CompactVector<uint64_t, 64> &cplain = plain;
+  uint64_t sum = 0;
+  t0 = GetTimestamp();
+  for (uint64_t val : cplain) {
+    sum += val;
+  }
+  t1 = GetTimestamp();
+  fprintf(stderr, "Time to scan 64-bit CompactVector = %llu; sum=%llu\n", (t1 - t0), (unsigned long long) sum);
+
+  sum = 0;
+  t0 = GetTimestamp();
+  for (size_t i = 0; i < RANGE_ARRAY_SIZE; i += RANGE_CHUNK_SIZE) {
+    pfor.GetRange(i, RANGE_CHUNK_SIZE, &chunk[0]);
+    for (size_t j = 0; j < RANGE_CHUNK_SIZE; j++) {
+      sum += chunk[j];
+    }
+  }
+  t1 = GetTimestamp();
+  fprintf(stderr, "Time to scan PForVector with GetRange = %llu; sum=%llu\n", (t1 - t0), (unsigned long long) sum);
+
+  std::vector<uint64_t> idx(NUM_RANDOM_READS);
+  for (auto &i : idx) {
+    i = gen() % RANGE_ARRAY_SIZE;
+  }
+  sum = 0;
+  t0 = GetTimestamp();
+  for (size_t i = 0; i < NUM_RANDOM_READS; i++) {
+    sum += pfor.Get(idx[i]);
+  }
+  t1 = GetTimestamp();
+  fprintf(stderr, "Time for random reads on PForVector = %llu; sum=%llu\n", (t1 - t0), (unsigned long long) sum);
+}
+
+static void BenchLowerBound() {
+  bits::CompactVector<uint64_t, 40> v(RANGE_ARRAY_SIZE);
+  for (size_t i = 0; i < RANGE_ARRAY_SIZE; i++) {
+    v.Set(i, i * 37);
+  }
+
+  std::mt19937_64 gen(0);
+  std::vector<uint64_t> queries(NUM_RANDOM_READS);
+  for (auto &q : queries) {
+    q = gen() % (RANGE_ARRAY_SIZE * 37ULL);
+  }
+
+  uint64_t sum = 0;
+  TimeStamp t0 = GetTimestamp();
+  for (size_t i = 0; i < NUM_RANDOM_READS; i++) {
+    sum += v.LowerBound(queries[i]);
+  }
+  TimeStamp t1 = GetTimestamp();
+  fprintf(stderr, "Time for LowerBound with binary search = %llu; sum=%llu\n", (t1 - t0), (unsigned long long) sum);
+
+  v.BuildSearchIndex();
+  sum = 0;
+  t0 = GetTimestamp();
+  for (size_t i = 0; i < NUM_RANDOM_READS; i++) {
+    sum += v.LowerBound(queries[i]);
+  }
+  t1 = GetTimestamp();
+  fprintf(stderr, "Time for LowerBound with search index = %llu; sum=%llu\n", (t1 - t0), (unsigned long long) sum);
+}
+
+static void BenchSort() {
+  size_t num_threads = std::max(std::thread::hardware_concurrency(), 1U);
+  std::mt19937_64 gen(0);
+  std::vector<uint64_t> values(RANGE_ARRAY_SIZE);
+  for (auto &val : values) {
+    val = gen() & low_bits_set[34];
+  }
+
+  bits::CompactVector<uint64_t, 34> v(RANGE_ARRAY_SIZE);
+  v.SetRange(0, RANGE_ARRAY_SIZE, &values[0]);
+  TimeStamp t0 = GetTimestamp();
+  bits::RadixSort<uint64_t, 34>::Sort(v);
+  TimeStamp t1 = GetTimestamp();
+  fprintf(stderr, "Time to radix sort CompactVector = %llu\n", (t1 - t0));
+
+  v.SetRange(0, RANGE_ARRAY_SIZE, &values[0]);
+  t0 = GetTimestamp();
+  bits::RadixSort<uint64_t, 34>::Sort(v, num_threads);
+  t1 = GetTimestamp();
+  fprintf(stderr, "Time to radix sort CompactVector with %zu threads = %llu\n", num_threads, (t1 - t0));
+
+  t0 = GetTimestamp();
+  std::sort(values.begin(), values.end());
+  t1 = GetTimestamp();
+  fprintf(stderr, "Time to std::sort unpacked values = %llu\n", (t1 - t0));
+}
+
+// Concurrent increments of random counters, packed in 20 bits vs. one
+// std::atomic per counter
+static void BenchAtomicCounters() {
+  size_t num_threads = std::max(std::thread::hardware_concurrency(), 1U);
+  bits::AtomicCompactVector<uint64_t, 20> packed(RANGE_ARRAY_SIZE);
+  std::vector<std::atomic<uint64_t>> unpacked(RANGE_ARRAY_SIZE);
+  for (auto &counter : unpacked) {
+    counter.store(0, std::memory_order_relaxed);
+  }
+
+  TimeStamp t0 = GetTimestamp();
+  std::vector<std::thread> threads;
+  for (size_t t = 0; t < num_threads; t++) {
+    threads.push_back(std::thread([&packed, t, num_threads]() {
+      std::mt19937_64 gen(t);
+      for (size_t i = 0; i < NUM_RANDOM_READS / num_threads; i++) {
+        packed.FetchAdd(gen() % RANGE_ARRAY_SIZE, 1);
+      }
+    }));
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  TimeStamp t1 = GetTimestamp();
+  fprintf(stderr, "Time for FetchAdd on AtomicCompactVector with %zu threads = %llu\n", num_threads, (t1 - t0));
+
+  t0 = GetTimestamp();
+  threads.clear();
+  for (size_t t = 0; t < num_threads; t++) {
+    threads.push_back(std::thread([&unpacked, t, num_threads]() {
+      std::mt19937_64 gen(t);
+      for (size_t i = 0; i < NUM_RANDOM_READS / num_threads; i++) {
+        unpacked[gen() % RANGE_ARRAY_SIZE].fetch_add(1, std::memory_order_relaxed);
+      }
+    }));
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  t1 = GetTimestamp();
+  fprintf(stderr, "Time for fetch_add on std::atomic<uint64_t> with %zu threads = %llu\n", num_threads, (t1 - t0));
+}
 
 int main(int argc, char **argv) {
   if (argc > 1) {
@@ -29,6 +342,40 @@ int main(int argc, char **argv) {
 
   fprintf(stderr, "Time to fill CompactVector = %llu\n", (t1 - t0));
 
+  {
+    size_t num_threads = std::max(std::thread::hardware_concurrency(), 1U);
+    bits::CompactVector<uint64_t, 30> parallel(ARRAY_SIZE);
+    t0 = GetTimestamp();
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < num_threads; t++) {
+      threads.push_back(std::thread([&parallel, t, num_threads]() {
+        size_t begin = ARRAY_SIZE / num_threads * t;
+        size_t end = (t == num_threads - 1) ? ARRAY_SIZE : ARRAY_SIZE / num_threads * (t + 1);
+        for (size_t i = begin; i < end; i++) {
+          parallel.AtomicSet(i, i);
+        }
+      }));
+    }
+    for (auto &thread : threads) {
+      thread.join();
+    }
+    t1 = GetTimestamp();
+
+    fprintf(stderr, "Time to fill CompactVector with %zu threads = %llu\n", num_threads, (t1 - t0));
+  }
+
+  {
+    bits::CompactVector<uint64_t, 30> reserved;
+    t0 = GetTimestamp();
+    reserved.Reserve(ARRAY_SIZE);
+    for (size_t i = 0; i < ARRAY_SIZE; i++) {
+      reserved.Append(i);
+    }
+    t1 = GetTimestamp();
+
+    fprintf(stderr, "Time to fill reserved CompactVector = %llu\n", (t1 - t0));
+  }
+
   int64_t sum = 0;
   t0 = GetTimestamp();
   for (size_t i = 0; i < ARRAY_SIZE; i++) {
@@ -38,4 +385,28 @@ int main(int argc, char **argv) {
   t1 = GetTimestamp();
 
   fprintf(stderr, "Time to read CompactVector = %llu; sum=%lld\n", (t1 - t0), sum);
+
+  sum = 0;
+  t0 = GetTimestamp();
+  const bits::CompactVector<uint64_t, 30> &cv = v;
+  for (uint64_t val : cv) {
+    sum += val;
+  }
+  t1 = GetTimestamp();
+
+  fprintf(stderr, "Time to read CompactVector with const_iterator = %llu; sum=%lld\n", (t1 - t0), sum);
+
+  bits::HugePageAllocator huge_page_allocator;
+  BenchRandomGet("malloc", bits::Allocator::Default());
+  BenchRandomGet("huge page", &huge_page_allocator);
+
+  BenchRangeOps<20>();
+  BenchRangeOps<33>();
+  BenchRangeOps<40>();
+  BenchByteAligned();
+  BenchDynamic();
+  BenchPFor();
+  BenchLowerBound();
+  BenchAtomicCounters();
+  BenchSort();
 }
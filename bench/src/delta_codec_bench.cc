@@ -0,0 +1,160 @@
+#include "delta_encoded_array.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <sstream>
+#include <vector>
+#include <sys/time.h>
+
+typedef unsigned long long int TimeStamp;
+static TimeStamp GetTimestamp() {
+  struct timeval now{};
+  gettimeofday(&now, nullptr);
+
+  return now.tv_usec + (TimeStamp) now.tv_sec * 1000000;
+}
+
+#define ARRAY_SIZE (4*1024*1024)
+#define NUM_QUERIES (1024*1024)
+#define CHUNK_SIZE 1024
+#define NUM_SMALL_LISTS (256*1024)
+#define SMALL_LIST_SIZE 48
+
+// Compares the delta codecs on lists with small and with large gaps: size,
+// random Get, Find and sequential decoding with DecodeRange; and the cost
+// of encoding and holding many small lists.
+
+template<typename Vector>
+static void BenchCodec(const char *name, std::vector<uint32_t> &values) {
+  TimeStamp t0, t1;
+
+  t0 = GetTimestamp();
+  Vector enc_array(&values[0], values.size());
+  t1 = GetTimestamp();
+
+  std::ostringstream out;
+  size_t size = enc_array.Serialize(out);
+  fprintf(stderr, "%s: bits per value = %.2f; time to encode = %llu\n", name, 8.0 * size / values.size(), (t1 - t0));
+
+  uint64_t sum = 0;
+  t0 = GetTimestamp();
+  for (uint64_t i = 0; i < NUM_QUERIES; i++) {
+    sum += enc_array[(i * 7919) % values.size()];
+  }
+  t1 = GetTimestamp();
+  fprintf(stderr, "%s: time for random Get = %llu; sum=%llu\n", name, (t1 - t0), (unsigned long long) sum);
+
+  uint64_t found = 0;
+  t0 = GetTimestamp();
+  for (uint64_t i = 0; i < NUM_QUERIES; i++) {
+    found += enc_array.Find(values[(i * 7919) % values.size()] + (i % 2));
+  }
+  t1 = GetTimestamp();
+  fprintf(stderr, "%s: time for Find = %llu; found=%llu\n", name, (t1 - t0), (unsigned long long) found);
+
+  uint32_t chunk[CHUNK_SIZE];
+  sum = 0;
+  t0 = GetTimestamp();
+  for (uint64_t i = 0; i < values.size(); i += CHUNK_SIZE) {
+    uint64_t count = std::min<uint64_t>(CHUNK_SIZE, values.size() - i);
+    enc_array.DecodeRange(i, count, chunk);
+    for (uint64_t j = 0; j < count; j++) {
+      sum += chunk[j];
+    }
+  }
+  t1 = GetTimestamp();
+  fprintf(stderr, "%s: time to decode ranges = %llu; sum=%llu\n", name, (t1 - t0), (unsigned long long) sum);
+}
+
+// Counts the storage allocated through it, to report the heap size of lists
+class CountingAllocator : public bits::MallocAllocator {
+ public:
+  void *Allocate(size_t num_bytes) override {
+    num_bytes_ += num_bytes;
+    num_allocations_++;
+    return MallocAllocator::Allocate(num_bytes);
+  }
+
+  void *Reallocate(void *ptr, size_t old_bytes, size_t new_bytes) override {
+    num_bytes_ += new_bytes - old_bytes;
+    num_allocations_ += (ptr == nullptr);
+    return MallocAllocator::Reallocate(ptr, old_bytes, new_bytes);
+  }
+
+  void Deallocate(void *ptr, size_t num_bytes) override {
+    num_bytes_ -= num_bytes;
+    num_allocations_ -= (ptr != nullptr);
+    MallocAllocator::Deallocate(ptr, num_bytes);
+  }
+
+  size_t num_bytes_ = 0;
+  size_t num_allocations_ = 0;
+};
+
+// Many small lists, as in an inverted index: time to encode them all, the
+// size of the list objects and of the storage they allocate, and the time
+// for a Get on each
+template<typename Vector>
+static void BenchSmallLists(const char *name) {
+  TimeStamp t0, t1;
+  std::mt19937 gen(0);
+  std::vector<uint32_t> values(NUM_SMALL_LISTS * SMALL_LIST_SIZE);
+  for (uint64_t i = 0; i < values.size(); i++) {
+    values[i] = (i % SMALL_LIST_SIZE == 0) ? gen() % 1024 : values[i - 1] + 1 + gen() % 1024;
+  }
+  std::vector<Vector *> lists(NUM_SMALL_LISTS);
+  CountingAllocator allocator;
+
+  t0 = GetTimestamp();
+  for (uint64_t l = 0; l < NUM_SMALL_LISTS; l++) {
+    lists[l] = new Vector(&values[l * SMALL_LIST_SIZE], SMALL_LIST_SIZE, &allocator);
+  }
+  t1 = GetTimestamp();
+  fprintf(stderr, "%s: time to encode %d lists = %llu; object size = %zu bytes\n", name, NUM_SMALL_LISTS, (t1 - t0),
+          sizeof(Vector));
+  fprintf(stderr, "%s: storage per list = %.1f bytes in %.1f allocations\n", name,
+          (double) allocator.num_bytes_ / NUM_SMALL_LISTS, (double) allocator.num_allocations_ / NUM_SMALL_LISTS);
+
+  uint64_t sum = 0;
+  t0 = GetTimestamp();
+  for (uint64_t l = 0; l < NUM_SMALL_LISTS; l++) {
+    sum += lists[(l * 7919) % NUM_SMALL_LISTS]->Get(l % SMALL_LIST_SIZE);
+  }
+  t1 = GetTimestamp();
+  fprintf(stderr, "%s: time for a Get on each list = %llu; sum=%llu\n", name, (t1 - t0), (unsigned long long) sum);
+
+  for (auto list : lists) {
+    delete list;
+  }
+}
+
+static void BenchCodecs(uint32_t max_gap) {
+  std::mt19937 gen(0);
+  std::vector<uint32_t> values(ARRAY_SIZE);
+  values[0] = 0;
+  for (uint64_t i = 1; i < ARRAY_SIZE; i++) {
+    values[i] = values[i - 1] + 1 + gen() % max_gap;
+  }
+
+  fprintf(stderr, "Gaps of up to %u:\n", max_gap);
+  BenchCodec<bits::EliasGammaDeltaEncodedVector<uint32_t>>("Elias gamma", values);
+  BenchCodec<bits::EliasDeltaDeltaEncodedVector<uint32_t>>("Elias delta", values);
+  BenchCodec<bits::GolombRiceDeltaEncodedVector<uint32_t>>("Golomb-Rice", values);
+  BenchCodec<bits::VByteDeltaEncodedVector<uint32_t>>("VByte", values);
+  BenchCodec<bits::StreamVByteDeltaEncodedVector<uint32_t>>("Stream VByte", values);
+}
+
+int main(int argc, char **argv) {
+  if (argc > 1) {
+    fprintf(stderr, "%s does not take any arguments.\n", argv[0]);
+  }
+
+  BenchCodecs(16);
+  BenchCodecs(1024);
+
+  fprintf(stderr, "Lists of %d values:\n", SMALL_LIST_SIZE);
+  BenchSmallLists<bits::EliasGammaDeltaEncodedVector<uint32_t>>("Elias gamma");
+  BenchSmallLists<bits::GolombRiceDeltaEncodedVector<uint32_t>>("Golomb-Rice");
+  BenchSmallLists<bits::StreamVByteDeltaEncodedVector<uint32_t>>("Stream VByte");
+}
@@ -0,0 +1,107 @@
+#include "dictionary.h"
+
+#include <cstdio>
+#include <random>
+#include <vector>
+#include <sys/time.h>
+
+typedef unsigned long long int TimeStamp;
+static TimeStamp GetTimestamp() {
+  struct timeval now{};
+  gettimeofday(&now, nullptr);
+
+  return now.tv_usec + (TimeStamp) now.tv_sec * 1000000;
+}
+
+#define BITMAP_SIZE (100*1024*1024)
+#define NUM_QUERIES (10*1024*1024)
+#define NUM_SCAN_QUERIES 32
+
+// Naive rank: popcount every word preceding the position
+static uint64_t ScanRank1(const bits::BitVector &bitmap, uint64_t i) {
+  const uint64_t *data = bitmap.GetData();
+  uint64_t count = 0;
+  for (uint64_t j = 0; j < i / 64; j++) {
+    count += bits::Utils::Popcount64bit(data[j]);
+  }
+  return count + bits::Utils::Popcount64bit(data[i / 64] & low_bits_set[i % 64]);
+}
+
+// Naive select: test every bit until the k-th set bit is reached
+static uint64_t ScanSelect1(const bits::BitVector &bitmap, uint64_t k) {
+  uint64_t i = 0;
+  for (;; i++) {
+    if (bitmap.GetBit(i) && k-- == 0)
+      break;
+  }
+  return i;
+}
+
+int main(int argc, char** argv) {
+  if (argc > 1) {
+    fprintf(stderr, "%s does not take any arguments.\n", argv[0]);
+  }
+
+  TimeStamp t0, t1;
+
+  std::mt19937_64 gen(0);
+  bits::BitVector bitmap(BITMAP_SIZE);
+  for (size_t i = 0; i < BITMAP_SIZE; i++) {
+    if (gen() % 2) {
+      bitmap.SetBit(i);
+    }
+  }
+
+  std::vector<uint64_t> queries(NUM_QUERIES);
+  for (auto &q : queries) {
+    q = gen() % BITMAP_SIZE;
+  }
+
+  t0 = GetTimestamp();
+  bits::Dictionary dict(bitmap);
+  t1 = GetTimestamp();
+
+  fprintf(stderr, "Time to build Dictionary = %llu\n", (t1 - t0));
+
+  uint64_t sum = 0;
+  t0 = GetTimestamp();
+  for (size_t i = 0; i < NUM_QUERIES; i++) {
+    sum += dict.rank1(queries[i]);
+  }
+  t1 = GetTimestamp();
+
+  fprintf(stderr, "Time per Dictionary rank1 = %lf; sum=%llu\n",
+          (double) (t1 - t0) / NUM_QUERIES, (unsigned long long) sum);
+
+  sum = 0;
+  t0 = GetTimestamp();
+  for (size_t i = 0; i < NUM_SCAN_QUERIES; i++) {
+    sum += ScanRank1(bitmap, queries[i]);
+  }
+  t1 = GetTimestamp();
+
+  fprintf(stderr, "Time per popcount scan rank1 = %lf; sum=%llu\n",
+          (double) (t1 - t0) / NUM_SCAN_QUERIES, (unsigned long long) sum);
+
+  uint64_t num_ones = dict.rank1(BITMAP_SIZE);
+
+  sum = 0;
+  t0 = GetTimestamp();
+  for (size_t i = 0; i < NUM_QUERIES; i++) {
+    sum += dict.select1(queries[i] % num_ones);
+  }
+  t1 = GetTimestamp();
+
+  fprintf(stderr, "Time per Dictionary select1 = %lf; sum=%llu\n",
+          (double) (t1 - t0) / NUM_QUERIES, (unsigned long long) sum);
+
+  sum = 0;
+  t0 = GetTimestamp();
+  for (size_t i = 0; i < NUM_SCAN_QUERIES; i++) {
+    sum += ScanSelect1(bitmap, queries[i] % num_ones);
+  }
+  t1 = GetTimestamp();
+
+  fprintf(stderr, "Time per GetBit scan select1 = %lf; sum=%llu\n",
+          (double) (t1 - t0) / NUM_SCAN_QUERIES, (unsigned long long) sum);
+}
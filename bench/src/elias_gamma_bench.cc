@@ -1,7 +1,10 @@
 #include "delta_encoded_array.h"
 #include "utils.h"
 
+#include <algorithm>
 #include <cstdio>
+#include <cstdlib>
+#include <vector>
 #include <sys/time.h>
 
 typedef unsigned long long int TimeStamp;
@@ -13,6 +16,7 @@ static TimeStamp GetTimestamp() {
 }
 
 #define ARRAY_SIZE (10*1024*1024)
+#define NUM_FIND_QUERIES (1024*1024)
 
 int main(int argc, char** argv) {
   if (argc > 1) {
@@ -44,6 +48,147 @@ int main(int argc, char** argv) {
   {
     auto *array = new uint64_t[ARRAY_SIZE];
 
+    // Random gaps, as in posting lists
+    t0 = GetTimestamp();
+    array[0] = 0;
+    for (uint64_t i = 1; i < ARRAY_SIZE; i++) {
+      array[i] = array[i - 1] + 1 + (rand() % 1024);
+    }
+    bits::EliasGammaDeltaEncodedVector<uint64_t> enc_array(array, ARRAY_SIZE);
+    t1 = GetTimestamp();
+
+    fprintf(stderr, "Time to fill Delta Encoded Array (random gaps) = %llu\n", (t1 - t0));
+
+    uint64_t sum = 0;
+    t0 = GetTimestamp();
+    for (uint64_t i = 0; i < ARRAY_SIZE; i++) {
+      sum += enc_array[i];
+    }
+    t1 = GetTimestamp();
+    fprintf(stderr, "Time to read Delta Encoded Array (random gaps) = %llu; sum=%lld\n", (t1 - t0), sum);
+
+    sum = 0;
+    t0 = GetTimestamp();
+    for (auto it = enc_array.begin(); it != enc_array.end(); ++it) {
+      sum += *it;
+    }
+    t1 = GetTimestamp();
+    fprintf(stderr, "Time to iterate Delta Encoded Array (random gaps) = %llu; sum=%lld\n", (t1 - t0), sum);
+
+    const uint64_t kChunkSize = 1024;
+    uint64_t chunk[kChunkSize];
+    sum = 0;
+    t0 = GetTimestamp();
+    for (uint64_t i = 0; i < ARRAY_SIZE; i += kChunkSize) {
+      uint64_t count = std::min<uint64_t>(kChunkSize, ARRAY_SIZE - i);
+      enc_array.DecodeRange(i, count, chunk);
+      for (uint64_t j = 0; j < count; j++) {
+        sum += chunk[j];
+      }
+    }
+    t1 = GetTimestamp();
+    fprintf(stderr, "Time to decode ranges of Delta Encoded Array (random gaps) = %llu; sum=%lld\n", (t1 - t0), sum);
+
+    uint64_t found = 0;
+    t0 = GetTimestamp();
+    for (uint64_t i = 0; i < NUM_FIND_QUERIES; i++) {
+      found += enc_array.Find(array[(i * 7919) % ARRAY_SIZE] + (i % 2));
+    }
+    t1 = GetTimestamp();
+    fprintf(stderr, "Time for Find on Delta Encoded Array (random gaps) = %llu; found=%llu\n", (t1 - t0),
+            (unsigned long long) found);
+
+    sum = 0;
+    t0 = GetTimestamp();
+    for (uint64_t i = 0; i < NUM_FIND_QUERIES; i++) {
+      sum += enc_array[(i * 7919) % ARRAY_SIZE];
+    }
+    t1 = GetTimestamp();
+    fprintf(stderr, "Time for random Get on Delta Encoded Array (random gaps) = %llu; sum=%lld\n", (t1 - t0), sum);
+
+    // A single sampling tier, for comparison
+    bits::EliasGammaDeltaEncodedVector<uint64_t, 128, 128> single_tier_array(array, ARRAY_SIZE);
+    sum = 0;
+    t0 = GetTimestamp();
+    for (uint64_t i = 0; i < NUM_FIND_QUERIES; i++) {
+      sum += single_tier_array[(i * 7919) % ARRAY_SIZE];
+    }
+    t1 = GetTimestamp();
+    fprintf(stderr, "Time for random Get without subsamples (random gaps) = %llu; sum=%lld\n", (t1 - t0), sum);
+
+    found = 0;
+    t0 = GetTimestamp();
+    for (uint64_t i = 0; i < NUM_FIND_QUERIES; i++) {
+      found += single_tier_array.Find(array[(i * 7919) % ARRAY_SIZE] + (i % 2));
+    }
+    t1 = GetTimestamp();
+    fprintf(stderr, "Time for Find without subsamples (random gaps) = %llu; found=%llu\n", (t1 - t0),
+            (unsigned long long) found);
+  }
+  {
+    auto *array = new uint64_t[ARRAY_SIZE];
+
+    // Sparse lists: gaps of up to 2^20, whose codes are wider than the 16-bit
+    // prefix sum table window
+    array[0] = 0;
+    for (uint64_t i = 1; i < ARRAY_SIZE; i++) {
+      array[i] = array[i - 1] + 1 + (rand() % (1 << 20));
+    }
+    bits::EliasGammaDeltaEncodedVector<uint64_t> enc_array(array, ARRAY_SIZE);
+
+    uint64_t sum = 0;
+    t0 = GetTimestamp();
+    for (auto it = enc_array.begin(); it != enc_array.end(); ++it) {
+      sum += *it;
+    }
+    t1 = GetTimestamp();
+    fprintf(stderr, "Time to iterate Delta Encoded Array (sparse) = %llu; sum=%lld\n", (t1 - t0), sum);
+
+    const uint64_t kChunkSize = 1024;
+    uint64_t chunk[kChunkSize];
+    sum = 0;
+    t0 = GetTimestamp();
+    for (uint64_t i = 0; i < ARRAY_SIZE; i += kChunkSize) {
+      uint64_t count = std::min<uint64_t>(kChunkSize, ARRAY_SIZE - i);
+      enc_array.DecodeRange(i, count, chunk);
+      for (uint64_t j = 0; j < count; j++) {
+        sum += chunk[j];
+      }
+    }
+    t1 = GetTimestamp();
+    fprintf(stderr, "Time to decode ranges of Delta Encoded Array (sparse) = %llu; sum=%lld\n", (t1 - t0), sum);
+
+    uint64_t found = 0;
+    t0 = GetTimestamp();
+    for (uint64_t i = 0; i < NUM_FIND_QUERIES; i++) {
+      found += enc_array.Find(array[(i * 7919) % ARRAY_SIZE] + (i % 2));
+    }
+    t1 = GetTimestamp();
+    fprintf(stderr, "Time for Find on Delta Encoded Array (sparse) = %llu; found=%llu\n", (t1 - t0),
+            (unsigned long long) found);
+
+    sum = 0;
+    t0 = GetTimestamp();
+    for (uint64_t i = 0; i < NUM_FIND_QUERIES; i++) {
+      sum += enc_array[(i * 7919) % ARRAY_SIZE];
+    }
+    t1 = GetTimestamp();
+    fprintf(stderr, "Time for random Get on Delta Encoded Array (sparse) = %llu; sum=%lld\n", (t1 - t0), sum);
+
+    std::vector<uint64_t> gaps(ARRAY_SIZE - 1);
+    for (uint64_t i = 1; i < ARRAY_SIZE; i++) {
+      gaps[i - 1] = array[i] - array[i - 1];
+    }
+    bits::BitVector codes = bits::EliasGammaEncoder<uint64_t>::EncodeArray(gaps);
+    t0 = GetTimestamp();
+    std::vector<uint64_t> decoded = bits::EliasGammaEncoder<uint64_t>::DecodeArray(codes);
+    t1 = GetTimestamp();
+    fprintf(stderr, "Time to decode Elias Gamma codes (sparse) = %llu; count=%llu\n", (t1 - t0),
+            (unsigned long long) decoded.size());
+  }
+  {
+    auto *array = new uint64_t[ARRAY_SIZE];
+
     t0 = GetTimestamp();
     for (size_t i = 0; i < ARRAY_SIZE; i++) {
       array[i] = i;
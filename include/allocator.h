@@ -0,0 +1,248 @@
+#ifndef BITMAP_ALLOCATOR_H_
+#define BITMAP_ALLOCATOR_H_
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <utility>
+#include <vector>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace bits {
+
+// Storage policy for BitVector-based structures. Allocations are always
+// zero-initialized, and Reallocate zeroes any bytes past the old size.
+// Allocators are not owned by the structures that use them, and must
+// outlive them.
+class Allocator {
+ public:
+  virtual ~Allocator() = default;
+
+  virtual void *Allocate(size_t num_bytes) = 0;
+
+  virtual void *Reallocate(void *ptr, size_t old_bytes, size_t new_bytes) {
+    void *new_ptr = Allocate(new_bytes);
+    if (ptr != nullptr) {
+      memcpy(new_ptr, ptr, std::min(old_bytes, new_bytes));
+      Deallocate(ptr, old_bytes);
+    }
+    return new_ptr;
+  }
+
+  virtual void Deallocate(void *ptr, size_t num_bytes) = 0;
+
+  // Allocator used when none is specified
+  static Allocator *Default();
+};
+
+// Plain malloc/realloc/free storage
+class MallocAllocator : public Allocator {
+ public:
+  void *Allocate(size_t num_bytes) override {
+    return calloc(num_bytes, 1);
+  }
+
+  void *Reallocate(void *ptr, size_t old_bytes, size_t new_bytes) override {
+    void *new_ptr = realloc(ptr, new_bytes);
+    if (new_bytes > old_bytes)
+      memset(static_cast<char *>(new_ptr) + old_bytes, 0, new_bytes - old_bytes);
+    return new_ptr;
+  }
+
+  void Deallocate(void *ptr, size_t) override {
+    free(ptr);
+  }
+};
+
+inline Allocator *Allocator::Default() {
+  static MallocAllocator allocator;
+  return &allocator;
+}
+
+// Storage aligned to the given boundary (a cache line by default)
+class AlignedAllocator : public Allocator {
+ public:
+  explicit AlignedAllocator(size_t alignment = 64) : alignment_(alignment) {}
+
+  void *Allocate(size_t num_bytes) override {
+    void *ptr = nullptr;
+    if (posix_memalign(&ptr, alignment_, std::max(num_bytes, alignment_)) != 0)
+      return nullptr;
+    memset(ptr, 0, num_bytes);
+    return ptr;
+  }
+
+  void Deallocate(void *ptr, size_t) override {
+    free(ptr);
+  }
+
+ private:
+  size_t alignment_;
+};
+
+// Anonymous mmap-backed storage aligned to 2MB, optionally backed by
+// transparent huge pages and bound to a NUMA node. Huge pages cut TLB
+// misses on large random-access structures; node-local placement avoids
+// remote-node latency on multi-socket machines.
+class PageAllocator : public Allocator {
+ public:
+  static const size_t kHugePageSize = 2ULL * 1024ULL * 1024ULL;
+
+  explicit PageAllocator(bool huge_pages = true, int numa_node = -1)
+      : huge_pages_(huge_pages),
+        numa_node_(numa_node) {
+  }
+
+  void *Allocate(size_t num_bytes) override {
+    size_t map_size = MapSize(num_bytes);
+
+    // Over-allocate so that the mapping can be trimmed to a 2MB boundary
+    void *base = mmap(nullptr, map_size + kHugePageSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (base == MAP_FAILED)
+      return nullptr;
+
+    uintptr_t start = reinterpret_cast<uintptr_t>(base);
+    uintptr_t aligned = (start + kHugePageSize - 1) & ~(kHugePageSize - 1);
+    if (aligned != start)
+      munmap(base, aligned - start);
+    if (aligned + map_size != start + map_size + kHugePageSize)
+      munmap(reinterpret_cast<void *>(aligned + map_size), start + kHugePageSize - aligned);
+
+    void *ptr = reinterpret_cast<void *>(aligned);
+#ifdef MADV_HUGEPAGE
+    if (huge_pages_)
+      madvise(ptr, map_size, MADV_HUGEPAGE);
+#endif
+    if (numa_node_ >= 0)
+      BindToNode(ptr, map_size);
+    return ptr;
+  }
+
+  void Deallocate(void *ptr, size_t num_bytes) override {
+    if (ptr != nullptr)
+      munmap(ptr, MapSize(num_bytes));
+  }
+
+ private:
+  static size_t MapSize(size_t num_bytes) {
+    size_t map_size = (num_bytes + kHugePageSize - 1) & ~(kHugePageSize - 1);
+    return (map_size == 0) ? kHugePageSize : map_size;
+  }
+
+  // Prefer (rather than require) the node, so that allocation does not
+  // fail when the node runs out of memory; pages are placed on first touch.
+  void BindToNode(void *ptr, size_t num_bytes) {
+#ifdef SYS_mbind
+    const int kMpolPreferred = 1;
+    const size_t kBitsPerLong = sizeof(unsigned long) * 8;
+    std::vector<unsigned long> node_mask(numa_node_ / kBitsPerLong + 1, 0);
+    node_mask[numa_node_ / kBitsPerLong] = 1UL << (numa_node_ % kBitsPerLong);
+    syscall(SYS_mbind, ptr, num_bytes, kMpolPreferred, node_mask.data(), node_mask.size() * kBitsPerLong + 1, 0);
+#endif
+  }
+
+  bool huge_pages_;
+  int numa_node_;
+};
+
+// Transparent huge page backed storage
+class HugePageAllocator : public PageAllocator {
+ public:
+  explicit HugePageAllocator(int numa_node = -1) : PageAllocator(true, numa_node) {}
+};
+
+// Storage placed on the given NUMA node
+class NumaAllocator : public PageAllocator {
+ public:
+  explicit NumaAllocator(int numa_node, bool huge_pages = false) : PageAllocator(huge_pages, numa_node) {}
+};
+
+// Bump allocator that carves allocations out of large chunks obtained from
+// an upstream allocator. Individual deallocations are no-ops (except for
+// the most recent allocation); all memory is released with the arena.
+class ArenaAllocator : public Allocator {
+ public:
+  static const size_t kAlignment = 64;
+
+  explicit ArenaAllocator(size_t chunk_size = 64ULL * 1024ULL * 1024ULL,
+                          Allocator *upstream = Allocator::Default())
+      : chunk_size_(chunk_size),
+        upstream_(upstream),
+        cur_(nullptr),
+        remaining_(0),
+        last_(nullptr) {
+  }
+
+  ArenaAllocator(const ArenaAllocator &) = delete;
+  ArenaAllocator &operator=(const ArenaAllocator &) = delete;
+
+  ~ArenaAllocator() override {
+    for (auto &chunk : chunks_) {
+      upstream_->Deallocate(chunk.first, chunk.second);
+    }
+  }
+
+  void *Allocate(size_t num_bytes) override {
+    size_t size = RoundUp(num_bytes);
+    if (size > remaining_) {
+      size_t chunk_size = std::max(chunk_size_, size + kAlignment);
+      char *chunk = static_cast<char *>(upstream_->Allocate(chunk_size));
+      chunks_.push_back(std::make_pair(chunk, chunk_size));
+      uintptr_t aligned = RoundUp(reinterpret_cast<uintptr_t>(chunk));
+      cur_ = reinterpret_cast<char *>(aligned);
+      remaining_ = chunk_size - (aligned - reinterpret_cast<uintptr_t>(chunk));
+    }
+
+    last_ = cur_;
+    cur_ += size;
+    remaining_ -= size;
+    return last_;
+  }
+
+  void *Reallocate(void *ptr, size_t old_bytes, size_t new_bytes) override {
+    // Grow or shrink the most recent allocation in place when possible
+    if (ptr != nullptr && ptr == last_) {
+      size_t old_size = RoundUp(old_bytes), new_size = RoundUp(new_bytes);
+      if (new_size <= old_size + remaining_) {
+        if (new_bytes > old_bytes)
+          memset(last_ + old_bytes, 0, new_bytes - old_bytes);
+        else
+          memset(last_ + new_bytes, 0, old_size - new_bytes);
+        cur_ = last_ + new_size;
+        remaining_ = remaining_ + old_size - new_size;
+        return ptr;
+      }
+    }
+    return Allocator::Reallocate(ptr, old_bytes, new_bytes);
+  }
+
+  void Deallocate(void *ptr, size_t num_bytes) override {
+    if (ptr != nullptr && ptr == last_) {
+      size_t size = RoundUp(num_bytes);
+      memset(last_, 0, size);
+      cur_ = last_;
+      remaining_ += size;
+      last_ = nullptr;
+    }
+  }
+
+ private:
+  static size_t RoundUp(size_t n) {
+    return (n + kAlignment - 1) & ~(kAlignment - 1);
+  }
+
+  size_t chunk_size_;
+  Allocator *upstream_;
+  std::vector<std::pair<char *, size_t>> chunks_;
+  char *cur_;
+  size_t remaining_;
+  char *last_;
+};
+
+}
+
+#endif // BITMAP_ALLOCATOR_H_
@@ -0,0 +1,240 @@
+#ifndef BITMAP_ATOMIC_COMPACT_VECTOR_H_
+#define BITMAP_ATOMIC_COMPACT_VECTOR_H_
+
+#include "bit_ops.h"
+#include "bit_vector.h"
+#include "cpu_info.h"
+
+#include <cstdint>
+#include <limits>
+
+namespace bits {
+
+// Vector of W-bit values that supports lock-free concurrent updates of
+// individual values (AtomicSet, FetchAdd, CompareExchange), e.g. for packed
+// counters updated from many threads.
+//
+// Unlike CompactVector, values are laid out in aligned 128-bit lanes, and a
+// value never crosses a lane boundary; a value that spans the two blocks
+// of its lane is updated with a single 16-byte compare-and-swap
+// (cmpxchg16b), and any other value with a 64-bit compare-and-swap of its
+// block. This costs the 128 % W bits at the end of every lane. Ordering is
+// relaxed, as for the atomic operations of BitVector.
+template<typename T, uint8_t W>
+class AtomicCompactVector : public BitVector {
+ public:
+  static_assert(!std::numeric_limits<T>::is_signed, "Signed types cannot be used.");
+  static_assert(W > 0 && W <= std::numeric_limits<T>::digits, "Width must fit the value type.");
+  // Type definitions
+  typedef typename BitVector::size_type size_type;
+  typedef typename BitVector::width_type width_type;
+  typedef typename BitVector::pos_type pos_type;
+  typedef typename BitVector::data_type data_type;
+  typedef T value_type;
+
+  // Constructors and destructors
+  AtomicCompactVector() : BitVector(), num_elements_(0) {}
+
+  // The allocator must return 16-byte aligned storage
+  explicit AtomicCompactVector(size_type num_elements, Allocator *allocator = Allocator::Default())
+      : BitVector(NumLanes(num_elements) * kLaneBits, allocator),
+        num_elements_(num_elements) {
+    assert(reinterpret_cast<uintptr_t>(data_) % sizeof(lane_type) == 0);
+  }
+
+  AtomicCompactVector(const AtomicCompactVector &) = delete;
+  AtomicCompactVector &operator=(const AtomicCompactVector &) = delete;
+
+  ~AtomicCompactVector() override = default;
+
+  width_type GetBitWidth() const {
+    return W;
+  }
+
+  size_type size() const {
+    return num_elements_;
+  }
+
+  bool empty() const {
+    return num_elements_ == 0;
+  }
+
+  // Accessors and mutators; none of these may be used on a mapped vector
+  // except Get and Load.
+
+  // Plain read; a value spanning two blocks may be torn if it is written
+  // concurrently (use Load instead)
+  T Get(pos_type i) const {
+    return (T) this->GetValPos(Position(i), W);
+  }
+
+  T operator[](pos_type i) const {
+    return Get(i);
+  }
+
+  // Atomic read
+  T Load(pos_type i) const {
+    // A mapped vector is read-only
+    if (IsMapped())
+      return Get(i);
+
+    pos_type pos = Position(i);
+    if (pos % 64 + W <= 64)
+      return (T) ((__atomic_load_n(&data_[pos / 64], __ATOMIC_RELAXED) >> (pos % 64)) & kMask);
+
+    // The compare-and-swap only writes the lane back if it holds 0
+    lane_type lane = 0;
+    CompareExchangeLane(Lane(pos), &lane, 0);
+    return (T) ((lane >> (pos % 128)) & kMask);
+  }
+
+  // Plain write, for values no other thread accesses
+  void Set(pos_type i, T value) {
+    this->SetValPos(Position(i), value, W);
+  }
+
+  void AtomicSet(pos_type i, T value) {
+    Update(i, [value](T, T *desired) {
+      *desired = value;
+      return true;
+    });
+  }
+
+  // Adds delta (modulo 2^W) to value i and returns the previous value
+  T FetchAdd(pos_type i, T delta) {
+    return Update(i, [delta](T old, T *desired) {
+      *desired = (T) ((old + delta) & kMask);
+      return true;
+    });
+  }
+
+  // Replaces value i with desired if it equals expected, and returns true;
+  // otherwise stores the current value in expected and returns false
+  bool CompareExchange(pos_type i, T &expected, T desired) {
+    T cmp = expected;
+    expected = Update(i, [cmp, desired](T old, T *new_value) {
+      *new_value = desired;
+      return old == cmp;
+    });
+    return expected == cmp;
+  }
+
+  // Serialization and De-serialization
+  size_type Serialize(std::ostream &out) override {
+    out.write(reinterpret_cast<const char *>(&num_elements_), sizeof(size_type));
+    return sizeof(size_type) + BitVector::Serialize(out);
+  }
+
+  size_type Deserialize(std::istream &in) override {
+    in.read(reinterpret_cast<char *>(&num_elements_), sizeof(size_type));
+    return sizeof(size_type) + BitVector::Deserialize(in);
+  }
+
+  size_type MemoryMap(const std::string &path, size_type offset = 0) override {
+    Destroy();
+
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+      return 0;
+    size_type num_elements;
+    ssize_t read_size = pread(fd, &num_elements, sizeof(size_type), offset);
+    close(fd);
+    if (read_size != sizeof(size_type))
+      return 0;
+
+    size_type in_size = BitVector::MemoryMap(path, offset + sizeof(size_type));
+    if (in_size == 0)
+      return 0;
+    num_elements_ = num_elements;
+    return sizeof(size_type) + in_size;
+  }
+
+ private:
+  typedef unsigned __int128 lane_type;
+
+  static const size_type kLaneBits = 128;
+  static const size_type kValuesPerLane = kLaneBits / W;
+  static const data_type kMask = (W == 64) ? ~0ULL : ((1ULL << (W % 64)) - 1);
+
+  static size_type NumLanes(size_type num_elements) {
+    return (num_elements + kValuesPerLane - 1) / kValuesPerLane;
+  }
+
+  // Bit position of value i
+  static pos_type Position(pos_type i) {
+    return (i / kValuesPerLane) * kLaneBits + (i % kValuesPerLane) * W;
+  }
+
+  lane_type *Lane(pos_type pos) const {
+    return reinterpret_cast<lane_type *>(data_ + (pos / kLaneBits) * 2);
+  }
+
+  // Atomically replaces value i with the value op(old, &desired) sets,
+  // unless op returns false; returns the previous value
+  template<typename Op>
+  T Update(pos_type i, Op op) {
+    assert(!IsMapped());
+    pos_type pos = Position(i);
+    pos_type s_off = pos % 64;
+    T old, desired;
+
+    if (s_off + W <= 64) {
+      data_type *block = &data_[pos / 64];
+      data_type expected = __atomic_load_n(block, __ATOMIC_RELAXED);
+      do {
+        old = (T) ((expected >> s_off) & kMask);
+        if (!op(old, &desired))
+          return old;
+      } while (!__atomic_compare_exchange_n(block, &expected,
+                                            (expected & ~(kMask << s_off)) | ((data_type) desired << s_off),
+                                            true, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+      return old;
+    }
+
+    // The value spans both blocks of its lane; a torn initial read only
+    // costs a failed compare-and-swap
+    lane_type *lane = Lane(pos);
+    pos_type l_off = pos % kLaneBits;
+    lane_type expected = ((lane_type) __atomic_load_n(&data_[pos / 64 + 1], __ATOMIC_RELAXED) << 64)
+        | __atomic_load_n(&data_[pos / 64], __ATOMIC_RELAXED);
+    do {
+      old = (T) ((expected >> l_off) & kMask);
+      if (!op(old, &desired))
+        return old;
+    } while (!CompareExchangeLane(lane, &expected,
+                                  (expected & ~((lane_type) kMask << l_off)) | ((lane_type) desired << l_off)));
+    return old;
+  }
+
+  // On failure, stores the current contents of the lane in expected
+#ifdef BITS_X86
+  BITS_TARGET("cx16")
+  static bool CompareExchangeLane(lane_type *lane, lane_type *expected, lane_type desired) {
+    lane_type prev = __sync_val_compare_and_swap(lane, *expected, desired);
+    if (prev == *expected)
+      return true;
+    *expected = prev;
+    return false;
+  }
+#else
+  // May need libatomic
+  static bool CompareExchangeLane(lane_type *lane, lane_type *expected, lane_type desired) {
+    return __atomic_compare_exchange_n(lane, expected, desired, false, __ATOMIC_RELAXED, __ATOMIC_RELAXED);
+  }
+#endif
+
+  size_type num_elements_;
+};
+
+template<typename T, uint8_t W>
+const typename AtomicCompactVector<T, W>::size_type AtomicCompactVector<T, W>::kLaneBits;
+
+template<typename T, uint8_t W>
+const typename AtomicCompactVector<T, W>::size_type AtomicCompactVector<T, W>::kValuesPerLane;
+
+template<typename T, uint8_t W>
+const typename AtomicCompactVector<T, W>::data_type AtomicCompactVector<T, W>::kMask;
+
+}
+
+#endif // BITMAP_ATOMIC_COMPACT_VECTOR_H_
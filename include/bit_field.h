@@ -0,0 +1,81 @@
+#ifndef BITMAP_BIT_FIELD_H_
+#define BITMAP_BIT_FIELD_H_
+
+#include <cstdint>
+
+#include "bit_ops.h"
+#include "cpu_info.h"
+#include "utils.h"
+
+namespace bits {
+
+// Bit-field primitives on 64-bit words: masking the low bits, extracting and
+// inserting a field, and selecting the k-th set bit.
+//
+// TableBitField takes its masks from the low_bits_set/low_bits_unset
+// tables, at the cost of a load per mask, and selects with broadword
+// arithmetic. BMI2BitField masks with BZHI and selects with PDEP. Hot
+// decoding loops are templates over the policy; they are instantiated for
+// BMI2BitField inside BITS_TARGET("bmi,bmi2") functions (so that their
+// shifts and trailing zero counts also use SHRX/SHLX and TZCNT), which are
+// picked at runtime when CpuInfo::HasBMI2().
+//
+// The bulk paths of the structures built on BitVector (BitPack's group
+// kernels, CompactVector::MultiGet) and Utils::Select64bit are dispatched the
+// same way. BitField is the policy of the single-value accessors
+// (GetValPos, SetValPos and their callers), for which a check on every
+// access would cost more than BMI2 saves: BMI2BitField when compiling for
+// BMI2 (e.g. -march=haswell), and TableBitField otherwise.
+struct TableBitField {
+  static uint64_t LowBits(uint64_t x, uint8_t bits) {
+    return x & low_bits_set[bits];
+  }
+
+  static uint64_t Extract(uint64_t x, uint8_t off, uint8_t bits) {
+    return (x >> off) & low_bits_set[bits];
+  }
+
+  // Replaces bits [off, off + bits) of x with val; off + bits must be <= 64
+  static uint64_t Insert(uint64_t x, uint64_t val, uint8_t off, uint8_t bits) {
+    return (x & (low_bits_set[off] | low_bits_unset[off + bits])) | (val << off);
+  }
+
+  static uint8_t SelectInWord(uint64_t x, uint8_t k) {
+    return Utils::BroadwordSelect64bit(x, k);
+  }
+};
+
+#ifdef BITS_X86
+// Must only be used if CpuInfo::HasBMI2(). The instructions are emitted with
+// inline assembly rather than intrinsics, so that the primitives inline
+// into any kernel, whether or not it is compiled for BMI2.
+struct BMI2BitField {
+  static uint64_t LowBits(uint64_t x, uint8_t bits) {
+    uint64_t out;
+    __asm__("bzhi %2, %1, %0" : "=r"(out) : "rm"(x), "r"((uint64_t) bits));
+    return out;
+  }
+
+  static uint64_t Extract(uint64_t x, uint8_t off, uint8_t bits) {
+    return LowBits(x >> off, bits);
+  }
+
+  static uint64_t Insert(uint64_t x, uint64_t val, uint8_t off, uint8_t bits) {
+    return (x & ~(LowBits(~0ULL, bits) << off)) | (val << off);
+  }
+
+  static uint8_t SelectInWord(uint64_t x, uint8_t k) {
+    return Utils::PdepSelect64bit(x, k);
+  }
+};
+#endif
+
+#ifdef __BMI2__
+typedef BMI2BitField BitField;
+#else
+typedef TableBitField BitField;
+#endif
+
+}
+
+#endif // BITMAP_BIT_FIELD_H_
@@ -0,0 +1,374 @@
+#ifndef BITMAP_BIT_OPS_H_
+#define BITMAP_BIT_OPS_H_
+
+#include <cstddef>
+#include <cstdint>
+
+#include "cpu_info.h"
+
+#ifdef BITS_X86
+#include <immintrin.h>
+#define BITS_TARGET(isa) __attribute__((target(isa)))
+#endif
+
+namespace bits {
+
+// Word-wise bitwise kernels over arrays of 64-bit blocks. Each operation
+// has a scalar and one or more SIMD implementations; the widest one the
+// CPU supports is picked the first time the operation is used.
+class BitOps {
+ public:
+  typedef uint64_t data_type;
+  typedef void (*kernel_type)(data_type *, const data_type *, const data_type *, size_t);
+  typedef size_t (*search_kernel_type)(const data_type *, size_t, size_t);
+  typedef uint64_t (*count_kernel_type)(const data_type *, size_t);
+  typedef void (*chunk_count_kernel_type)(const data_type *, size_t, uint16_t *);
+
+  // out[i] = a[i] & b[i]
+  static void And(data_type *out, const data_type *a, const data_type *b, size_t num_blocks) {
+    Apply<AndOp>(out, a, b, num_blocks);
+  }
+
+  // out[i] = a[i] | b[i]
+  static void Or(data_type *out, const data_type *a, const data_type *b, size_t num_blocks) {
+    Apply<OrOp>(out, a, b, num_blocks);
+  }
+
+  // out[i] = a[i] ^ b[i]
+  static void Xor(data_type *out, const data_type *a, const data_type *b, size_t num_blocks) {
+    Apply<XorOp>(out, a, b, num_blocks);
+  }
+
+  // out[i] = a[i] & ~b[i]
+  static void AndNot(data_type *out, const data_type *a, const data_type *b, size_t num_blocks) {
+    Apply<AndNotOp>(out, a, b, num_blocks);
+  }
+
+  // out[i] = ~a[i]
+  static void Not(data_type *out, const data_type *a, size_t num_blocks) {
+    Apply<NotOp>(out, a, a, num_blocks);
+  }
+
+  // Index of the first non-zero block in [begin, end), or end if there is none
+  static size_t FindNonZero(const data_type *data, size_t begin, size_t end) {
+    static const search_kernel_type kernel = SelectSearchKernel();
+    return kernel(data, begin, end);
+  }
+
+  // Number of set bits in the blocks
+  static uint64_t Popcount(const data_type *data, size_t num_blocks) {
+    static const count_kernel_type kernel = SelectCountKernel();
+    return kernel(data, num_blocks);
+  }
+
+  // Number of set bits in each of num_chunks consecutive 512-bit chunks
+  static void Popcount512bit(const data_type *data, size_t num_chunks, uint16_t *counts) {
+    static const chunk_count_kernel_type kernel = SelectChunkCountKernel();
+    kernel(data, num_chunks, counts);
+  }
+
+ private:
+  struct AndOp {
+    static data_type Word(data_type a, data_type b) { return a & b; }
+#ifdef BITS_X86
+    BITS_TARGET("avx2") static __m256i AVX2(__m256i a, __m256i b) { return _mm256_and_si256(a, b); }
+    BITS_TARGET("avx512f") static __m512i AVX512(__m512i a, __m512i b) { return _mm512_and_si512(a, b); }
+#endif
+  };
+
+  struct OrOp {
+    static data_type Word(data_type a, data_type b) { return a | b; }
+#ifdef BITS_X86
+    BITS_TARGET("avx2") static __m256i AVX2(__m256i a, __m256i b) { return _mm256_or_si256(a, b); }
+    BITS_TARGET("avx512f") static __m512i AVX512(__m512i a, __m512i b) { return _mm512_or_si512(a, b); }
+#endif
+  };
+
+  struct XorOp {
+    static data_type Word(data_type a, data_type b) { return a ^ b; }
+#ifdef BITS_X86
+    BITS_TARGET("avx2") static __m256i AVX2(__m256i a, __m256i b) { return _mm256_xor_si256(a, b); }
+    BITS_TARGET("avx512f") static __m512i AVX512(__m512i a, __m512i b) { return _mm512_xor_si512(a, b); }
+#endif
+  };
+
+  struct AndNotOp {
+    static data_type Word(data_type a, data_type b) { return a & ~b; }
+#ifdef BITS_X86
+    // The andnot intrinsics negate their first operand
+    BITS_TARGET("avx2") static __m256i AVX2(__m256i a, __m256i b) { return _mm256_andnot_si256(b, a); }
+    BITS_TARGET("avx512f") static __m512i AVX512(__m512i a, __m512i b) { return _mm512_andnot_si512(b, a); }
+#endif
+  };
+
+  struct NotOp {
+    static data_type Word(data_type a, data_type) { return ~a; }
+#ifdef BITS_X86
+    BITS_TARGET("avx2") static __m256i AVX2(__m256i a, __m256i) {
+      return _mm256_xor_si256(a, _mm256_set1_epi64x(-1LL));
+    }
+    BITS_TARGET("avx512f") static __m512i AVX512(__m512i a, __m512i) {
+      return _mm512_xor_si512(a, _mm512_set1_epi64(-1LL));
+    }
+#endif
+  };
+
+  template<typename Op>
+  static void ScalarKernel(data_type *out, const data_type *a, const data_type *b, size_t num_blocks) {
+    for (size_t i = 0; i < num_blocks; i++) {
+      out[i] = Op::Word(a[i], b[i]);
+    }
+  }
+
+#ifdef BITS_X86
+  template<typename Op>
+  BITS_TARGET("avx2")
+  static void AVX2Kernel(data_type *out, const data_type *a, const data_type *b, size_t num_blocks) {
+    size_t i = 0;
+    for (; i + 4 <= num_blocks; i += 4) {
+      __m256i va = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(a + i));
+      __m256i vb = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(b + i));
+      _mm256_storeu_si256(reinterpret_cast<__m256i *>(out + i), Op::AVX2(va, vb));
+    }
+    for (; i < num_blocks; i++) {
+      out[i] = Op::Word(a[i], b[i]);
+    }
+  }
+
+  template<typename Op>
+  BITS_TARGET("avx512f")
+  static void AVX512Kernel(data_type *out, const data_type *a, const data_type *b, size_t num_blocks) {
+    size_t i = 0;
+    for (; i + 8 <= num_blocks; i += 8) {
+      __m512i va = _mm512_loadu_si512(a + i);
+      __m512i vb = _mm512_loadu_si512(b + i);
+      _mm512_storeu_si512(out + i, Op::AVX512(va, vb));
+    }
+    for (; i < num_blocks; i++) {
+      out[i] = Op::Word(a[i], b[i]);
+    }
+  }
+#endif
+
+  static size_t ScalarFindNonZero(const data_type *data, size_t begin, size_t end) {
+    while (begin < end && data[begin] == 0)
+      begin++;
+    return begin;
+  }
+
+#ifdef BITS_X86
+  BITS_TARGET("avx2")
+  static size_t AVX2FindNonZero(const data_type *data, size_t begin, size_t end) {
+    for (; begin + 4 <= end; begin += 4) {
+      __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + begin));
+      if (!_mm256_testz_si256(v, v))
+        break;
+    }
+    return ScalarFindNonZero(data, begin, end);
+  }
+
+  BITS_TARGET("avx512f")
+  static size_t AVX512FindNonZero(const data_type *data, size_t begin, size_t end) {
+    for (; begin + 8 <= end; begin += 8) {
+      __m512i v = _mm512_loadu_si512(data + begin);
+      if (_mm512_test_epi64_mask(v, v) != 0)
+        break;
+    }
+    return ScalarFindNonZero(data, begin, end);
+  }
+#endif
+
+  static search_kernel_type SelectSearchKernel() {
+#ifdef BITS_X86
+    if (CpuInfo::HasAVX512F())
+      return AVX512FindNonZero;
+    if (CpuInfo::HasAVX2())
+      return AVX2FindNonZero;
+#endif
+    return ScalarFindNonZero;
+  }
+
+  static uint64_t ScalarPopcount(const data_type *data, size_t num_blocks) {
+    uint64_t count = 0;
+    for (size_t i = 0; i < num_blocks; i++) {
+      count += __builtin_popcountll(data[i]);
+    }
+    return count;
+  }
+
+  static void ScalarPopcount512bit(const data_type *data, size_t num_chunks, uint16_t *counts) {
+    for (size_t i = 0; i < num_chunks; i++) {
+      counts[i] = (uint16_t) ScalarPopcount(data + i * 8, 8);
+    }
+  }
+
+#ifdef BITS_X86
+  BITS_TARGET("popcnt")
+  static uint64_t POPCNTPopcount(const data_type *data, size_t num_blocks) {
+    uint64_t count = 0;
+    for (size_t i = 0; i < num_blocks; i++) {
+      count += __builtin_popcountll(data[i]);
+    }
+    return count;
+  }
+
+  BITS_TARGET("popcnt")
+  static void POPCNTPopcount512bit(const data_type *data, size_t num_chunks, uint16_t *counts) {
+    for (size_t i = 0; i < num_chunks; i++) {
+      const data_type *chunk = data + i * 8;
+      counts[i] = (uint16_t) (__builtin_popcountll(chunk[0]) + __builtin_popcountll(chunk[1])
+          + __builtin_popcountll(chunk[2]) + __builtin_popcountll(chunk[3])
+          + __builtin_popcountll(chunk[4]) + __builtin_popcountll(chunk[5])
+          + __builtin_popcountll(chunk[6]) + __builtin_popcountll(chunk[7]));
+    }
+  }
+
+  // Per-64-bit-lane popcount via a nibble lookup table (Mula et al.)
+  BITS_TARGET("avx2")
+  static __m256i AVX2LanePopcount(__m256i v) {
+    const __m256i lookup = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+                                            0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+    const __m256i low_mask = _mm256_set1_epi8(0x0F);
+    __m256i lo = _mm256_shuffle_epi8(lookup, _mm256_and_si256(v, low_mask));
+    __m256i hi = _mm256_shuffle_epi8(lookup, _mm256_and_si256(_mm256_srli_epi32(v, 4), low_mask));
+    return _mm256_sad_epu8(_mm256_add_epi8(lo, hi), _mm256_setzero_si256());
+  }
+
+  BITS_TARGET("avx2")
+  static void CSA(__m256i *h, __m256i *l, __m256i a, __m256i b, __m256i c) {
+    __m256i u = _mm256_xor_si256(a, b);
+    *h = _mm256_or_si256(_mm256_and_si256(a, b), _mm256_and_si256(u, c));
+    *l = _mm256_xor_si256(u, c);
+  }
+
+  BITS_TARGET("avx2")
+  static uint64_t AVX2HorizontalSum(__m256i v) {
+    return (uint64_t) _mm256_extract_epi64(v, 0) + (uint64_t) _mm256_extract_epi64(v, 1)
+        + (uint64_t) _mm256_extract_epi64(v, 2) + (uint64_t) _mm256_extract_epi64(v, 3);
+  }
+
+  // Harley-Seal carry-save adder popcount over 16 vectors at a time
+  // "Faster Population Counts Using AVX2 Instructions", Mula, Kurz & Lemire
+  BITS_TARGET("avx2,popcnt")
+  static uint64_t AVX2Popcount(const data_type *data, size_t num_blocks) {
+    const __m256i *v = reinterpret_cast<const __m256i *>(data);
+    size_t num_vectors = num_blocks / 4;
+    __m256i total = _mm256_setzero_si256();
+    __m256i ones = _mm256_setzero_si256(), twos = _mm256_setzero_si256();
+    __m256i fours = _mm256_setzero_si256(), eights = _mm256_setzero_si256(), sixteens;
+    __m256i twos_a, twos_b, fours_a, fours_b, eights_a, eights_b;
+
+    size_t i = 0;
+    for (; i + 16 <= num_vectors; i += 16) {
+      CSA(&twos_a, &ones, ones, _mm256_loadu_si256(v + i), _mm256_loadu_si256(v + i + 1));
+      CSA(&twos_b, &ones, ones, _mm256_loadu_si256(v + i + 2), _mm256_loadu_si256(v + i + 3));
+      CSA(&fours_a, &twos, twos, twos_a, twos_b);
+      CSA(&twos_a, &ones, ones, _mm256_loadu_si256(v + i + 4), _mm256_loadu_si256(v + i + 5));
+      CSA(&twos_b, &ones, ones, _mm256_loadu_si256(v + i + 6), _mm256_loadu_si256(v + i + 7));
+      CSA(&fours_b, &twos, twos, twos_a, twos_b);
+      CSA(&eights_a, &fours, fours, fours_a, fours_b);
+      CSA(&twos_a, &ones, ones, _mm256_loadu_si256(v + i + 8), _mm256_loadu_si256(v + i + 9));
+      CSA(&twos_b, &ones, ones, _mm256_loadu_si256(v + i + 10), _mm256_loadu_si256(v + i + 11));
+      CSA(&fours_a, &twos, twos, twos_a, twos_b);
+      CSA(&twos_a, &ones, ones, _mm256_loadu_si256(v + i + 12), _mm256_loadu_si256(v + i + 13));
+      CSA(&twos_b, &ones, ones, _mm256_loadu_si256(v + i + 14), _mm256_loadu_si256(v + i + 15));
+      CSA(&fours_b, &twos, twos, twos_a, twos_b);
+      CSA(&eights_b, &fours, fours, fours_a, fours_b);
+      CSA(&sixteens, &eights, eights, eights_a, eights_b);
+      total = _mm256_add_epi64(total, AVX2LanePopcount(sixteens));
+    }
+
+    total = _mm256_slli_epi64(total, 4);
+    total = _mm256_add_epi64(total, _mm256_slli_epi64(AVX2LanePopcount(eights), 3));
+    total = _mm256_add_epi64(total, _mm256_slli_epi64(AVX2LanePopcount(fours), 2));
+    total = _mm256_add_epi64(total, _mm256_slli_epi64(AVX2LanePopcount(twos), 1));
+    total = _mm256_add_epi64(total, AVX2LanePopcount(ones));
+    for (; i < num_vectors; i++) {
+      total = _mm256_add_epi64(total, AVX2LanePopcount(_mm256_loadu_si256(v + i)));
+    }
+
+    uint64_t count = AVX2HorizontalSum(total);
+    for (size_t j = num_vectors * 4; j < num_blocks; j++) {
+      count += __builtin_popcountll(data[j]);
+    }
+    return count;
+  }
+
+  BITS_TARGET("avx2")
+  static void AVX2Popcount512bit(const data_type *data, size_t num_chunks, uint16_t *counts) {
+    const __m256i *v = reinterpret_cast<const __m256i *>(data);
+    for (size_t i = 0; i < num_chunks; i++) {
+      __m256i lanes = _mm256_add_epi64(AVX2LanePopcount(_mm256_loadu_si256(v + 2 * i)),
+                                       AVX2LanePopcount(_mm256_loadu_si256(v + 2 * i + 1)));
+      counts[i] = (uint16_t) AVX2HorizontalSum(lanes);
+    }
+  }
+
+  BITS_TARGET("avx512f,avx512vpopcntdq,popcnt")
+  static uint64_t AVX512Popcount(const data_type *data, size_t num_blocks) {
+    __m512i total = _mm512_setzero_si512();
+    size_t i = 0;
+    for (; i + 8 <= num_blocks; i += 8) {
+      total = _mm512_add_epi64(total, _mm512_popcnt_epi64(_mm512_loadu_si512(data + i)));
+    }
+
+    uint64_t count = (uint64_t) _mm512_reduce_add_epi64(total);
+    for (; i < num_blocks; i++) {
+      count += __builtin_popcountll(data[i]);
+    }
+    return count;
+  }
+
+  BITS_TARGET("avx512f,avx512vpopcntdq")
+  static void AVX512Popcount512bit(const data_type *data, size_t num_chunks, uint16_t *counts) {
+    for (size_t i = 0; i < num_chunks; i++) {
+      counts[i] = (uint16_t) _mm512_reduce_add_epi64(_mm512_popcnt_epi64(_mm512_loadu_si512(data + i * 8)));
+    }
+  }
+#endif
+
+  static count_kernel_type SelectCountKernel() {
+#ifdef BITS_X86
+    if (CpuInfo::HasAVX512VPOPCNTDQ())
+      return AVX512Popcount;
+    if (CpuInfo::HasAVX2() && CpuInfo::HasPOPCNT())
+      return AVX2Popcount;
+    if (CpuInfo::HasPOPCNT())
+      return POPCNTPopcount;
+#endif
+    return ScalarPopcount;
+  }
+
+  static chunk_count_kernel_type SelectChunkCountKernel() {
+#ifdef BITS_X86
+    if (CpuInfo::HasAVX512VPOPCNTDQ())
+      return AVX512Popcount512bit;
+    if (CpuInfo::HasPOPCNT())
+      return POPCNTPopcount512bit;
+    if (CpuInfo::HasAVX2())
+      return AVX2Popcount512bit;
+#endif
+    return ScalarPopcount512bit;
+  }
+
+  template<typename Op>
+  static kernel_type SelectKernel() {
+#ifdef BITS_X86
+    if (CpuInfo::HasAVX512F())
+      return AVX512Kernel<Op>;
+    if (CpuInfo::HasAVX2())
+      return AVX2Kernel<Op>;
+#endif
+    return ScalarKernel<Op>;
+  }
+
+  template<typename Op>
+  static void Apply(data_type *out, const data_type *a, const data_type *b, size_t num_blocks) {
+    static const kernel_type kernel = SelectKernel<Op>();
+    kernel(out, a, b, num_blocks);
+  }
+};
+
+}
+
+#endif // BITMAP_BIT_OPS_H_
@@ -0,0 +1,272 @@
+#ifndef BITMAP_BIT_PACK_H_
+#define BITMAP_BIT_PACK_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <type_traits>
+
+#include "bit_ops.h"
+#include "cpu_info.h"
+#include "utils.h"
+
+namespace bits {
+
+// Bulk packing and unpacking of W-bit values stored back to back in 64-bit
+// blocks. Every 64 values occupy exactly W blocks, so whole groups of 64
+// values are converted with fully unrolled code in which every block index
+// and shift is a compile-time constant; only the values before the first
+// and after the last whole group are converted one at a time. The group
+// kernels are picked once on the CPU: unpacking has an AVX2 kernel for
+// widths up to 56 bits and 32/64-bit values, and both directions otherwise
+// use the scalar code compiled for BMI2 (SHLX/SHRX) if the CPU supports it.
+template<typename T, uint8_t W>
+class BitPack {
+ public:
+  typedef uint64_t data_type;
+  typedef void (*unpack_kernel_type)(const data_type *, size_t, T *);
+  typedef void (*pack_kernel_type)(const T *, size_t, data_type *);
+
+  static_assert(W > 0 && W <= 64, "Width must be between 1 and 64 bits.");
+
+  // Unpacks count values starting at value `start` into out; data holds
+  // num_blocks blocks.
+  static void Unpack(const data_type *data, size_t num_blocks, size_t start, size_t count, T *out) {
+    size_t i = start, end = start + count;
+    for (size_t head = HeadCount(start, count); head != 0; head--, i++) {
+      *out++ = Get(data, i);
+    }
+
+    const data_type *in = data + (i / 64) * W;
+    size_t num_groups = (end - i) / 64;
+    if (num_groups != 0) {
+      // The vector kernel may read up to 8 bytes past the last group
+      size_t num_vector_groups = (in + num_groups * W < data + num_blocks) ? num_groups : num_groups - 1;
+      static const unpack_kernel_type kernel = SelectUnpackKernel();
+      kernel(in, num_vector_groups, out);
+      for (size_t g = num_vector_groups; g < num_groups; g++) {
+        UnpackGroup(in + g * W, out + g * 64, std::integral_constant<size_t, 0>());
+      }
+      i += num_groups * 64;
+      out += num_groups * 64;
+    }
+
+    // Fewer than 64 values remain
+    for (size_t tail = (end - i) % 64; tail != 0; tail--, i++) {
+      *out++ = Get(data, i);
+    }
+  }
+
+  // Packs count values (each of which must fit in W bits) from in, starting
+  // at value `start`; bits outside the range are preserved.
+  static void Pack(data_type *data, size_t start, size_t count, const T *in) {
+    size_t i = start, end = start + count;
+    for (size_t head = HeadCount(start, count); head != 0; head--, i++) {
+      Set(data, i, *in++);
+    }
+
+    size_t num_groups = (end - i) / 64;
+    if (num_groups != 0) {
+      static const pack_kernel_type kernel = SelectPackKernel();
+      kernel(in, num_groups, data + (i / 64) * W);
+      i += num_groups * 64;
+      in += num_groups * 64;
+    }
+
+    for (size_t tail = (end - i) % 64; tail != 0; tail--, i++) {
+      Set(data, i, *in++);
+    }
+  }
+
+ private:
+  // Number of values before the first whole group
+  static size_t HeadCount(size_t start, size_t count) {
+    size_t head = (64 - start % 64) % 64;
+    return (head < count) ? head : count;
+  }
+
+  static const data_type kMask = (W == 64) ? ~0ULL : ((1ULL << (W % 64)) - 1);
+
+  static T Get(const data_type *data, size_t i) {
+    size_t pos = i * W;
+    size_t s_idx = pos / 64, s_off = pos % 64;
+    if (s_off + W <= 64)
+      return (T) ((data[s_idx] >> s_off) & kMask);
+    return (T) (((data[s_idx] >> s_off) | (data[s_idx + 1] << (64 - s_off))) & kMask);
+  }
+
+  static void Set(data_type *data, size_t i, T value) {
+    size_t pos = i * W;
+    size_t s_idx = pos / 64, s_off = pos % 64;
+    data_type val = value;
+    if (s_off + W <= 64) {
+      data_type mask = kMask << s_off;
+      data[s_idx] = (data[s_idx] & ~mask) | (val << s_off);
+    } else {
+      data[s_idx] = (data[s_idx] & low_bits_set[s_off]) | (val << s_off);
+      data[s_idx + 1] = (data[s_idx + 1] & low_bits_unset[(s_off + W) % 64]) | (val >> (64 - s_off));
+    }
+  }
+
+  // Value J of a group of 64 values starting at block `in`
+  template<size_t J>
+  static T Extract(const data_type *in) {
+    const size_t s_idx = (J * W) / 64, s_off = (J * W) % 64;
+    if (s_off + W <= 64)
+      return (T) ((in[s_idx] >> s_off) & kMask);
+    return (T) (((in[s_idx] >> s_off) | (in[s_idx + 1] << ((64 - s_off) % 64))) & kMask);
+  }
+
+  static void UnpackGroup(const data_type *, T *, std::integral_constant<size_t, 64>) {}
+
+  template<size_t J>
+  static void UnpackGroup(const data_type *in, T *out, std::integral_constant<size_t, J>) {
+    out[J] = Extract<J>(in);
+    UnpackGroup(in, out, std::integral_constant<size_t, J + 1>());
+  }
+
+  static void PackGroup(const T *, data_type *, std::integral_constant<size_t, 64>) {}
+
+  // Every block of the group is first assigned, either by the value that
+  // starts at its first bit or by the spill of the value before it.
+  template<size_t J>
+  static void PackGroup(const T *in, data_type *out, std::integral_constant<size_t, J>) {
+    const size_t s_idx = (J * W) / 64, s_off = (J * W) % 64;
+    data_type val = in[J];
+    if (s_off == 0)
+      out[s_idx] = val;
+    else
+      out[s_idx] |= val << s_off;
+    if (s_off + W > 64)
+      out[s_idx + 1] = val >> ((64 - s_off) % 64);
+    PackGroup(in, out, std::integral_constant<size_t, J + 1>());
+  }
+
+  static void ScalarUnpack(const data_type *in, size_t num_groups, T *out) {
+    for (size_t g = 0; g < num_groups; g++, in += W, out += 64) {
+      UnpackGroup(in, out, std::integral_constant<size_t, 0>());
+    }
+  }
+
+  static void ScalarPack(const T *in, size_t num_groups, data_type *out) {
+    for (size_t g = 0; g < num_groups; g++, in += 64, out += W) {
+      PackGroup(in, out, std::integral_constant<size_t, 0>());
+    }
+  }
+
+#ifdef BITS_X86
+  BITS_TARGET("bmi,bmi2")
+  static void BMI2Unpack(const data_type *in, size_t num_groups, T *out) {
+    ScalarUnpack(in, num_groups, out);
+  }
+
+  BITS_TARGET("bmi,bmi2")
+  static void BMI2Pack(const T *in, size_t num_groups, data_type *out) {
+    ScalarPack(in, num_groups, out);
+  }
+#endif
+
+#ifdef BITS_X86
+  // Each 8 consecutive values occupy exactly W bytes; value k of each such
+  // run is an unaligned 64-bit load at byte (k * W) / 8, shifted right by
+  // (k * W) % 8 bits. Requires W <= 56 so that the shifted value fits.
+  BITS_TARGET("avx2")
+  static void AVX2Unpack(const data_type *in, size_t num_groups, T *out) {
+    const __m256i lo_idx = _mm256_setr_epi64x(0, W / 8, (2 * W) / 8, (3 * W) / 8);
+    const __m256i hi_idx = _mm256_setr_epi64x((4 * W) / 8, (5 * W) / 8, (6 * W) / 8, (7 * W) / 8);
+    const __m256i lo_shift = _mm256_setr_epi64x(0, W % 8, (2 * W) % 8, (3 * W) % 8);
+    const __m256i hi_shift = _mm256_setr_epi64x((4 * W) % 8, (5 * W) % 8, (6 * W) % 8, (7 * W) % 8);
+    const __m256i mask = _mm256_set1_epi64x((long long) kMask);
+    const __m256i narrow = _mm256_setr_epi32(0, 2, 4, 6, 1, 3, 5, 7);
+
+    const long long *bytes = reinterpret_cast<const long long *>(in);
+    size_t num_runs = num_groups * 8;
+    for (size_t r = 0; r < num_runs; r++, out += 8) {
+      const long long *base = reinterpret_cast<const long long *>(reinterpret_cast<const char *>(bytes) + r * W);
+      __m256i lo = _mm256_i64gather_epi64(base, lo_idx, 1);
+      __m256i hi = _mm256_i64gather_epi64(base, hi_idx, 1);
+      lo = _mm256_and_si256(_mm256_srlv_epi64(lo, lo_shift), mask);
+      hi = _mm256_and_si256(_mm256_srlv_epi64(hi, hi_shift), mask);
+      if (sizeof(T) == 8) {
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(out), lo);
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(out + 4), hi);
+      } else {
+        __m128i lo32 = _mm256_castsi256_si128(_mm256_permutevar8x32_epi32(lo, narrow));
+        __m128i hi32 = _mm256_castsi256_si128(_mm256_permutevar8x32_epi32(hi, narrow));
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(out),
+                            _mm256_inserti128_si256(_mm256_castsi128_si256(lo32), hi32, 1));
+      }
+    }
+  }
+#endif
+
+  static unpack_kernel_type SelectUnpackKernel() {
+#ifdef BITS_X86
+    if (W <= 56 && (sizeof(T) == 8 || sizeof(T) == 4) && CpuInfo::HasAVX2())
+      return AVX2Unpack;
+    if (CpuInfo::HasBMI2())
+      return BMI2Unpack;
+#endif
+    return ScalarUnpack;
+  }
+
+  static pack_kernel_type SelectPackKernel() {
+#ifdef BITS_X86
+    if (CpuInfo::HasBMI2())
+      return BMI2Pack;
+#endif
+    return ScalarPack;
+  }
+};
+
+template<typename T, uint8_t W>
+const typename BitPack<T, W>::data_type BitPack<T, W>::kMask;
+
+// BitPack kernels indexed by width, for structures whose widths are only
+// known at runtime; the table is built once per value type.
+template<typename T>
+class BitPackKernels {
+ public:
+  typedef uint64_t data_type;
+  typedef void (*unpack_kernel_type)(const data_type *, size_t, size_t, size_t, T *);
+  typedef void (*pack_kernel_type)(data_type *, size_t, size_t, const T *);
+
+  static const int kMaxWidth = std::numeric_limits<T>::digits;
+
+  // Kernels for widths 1 to kMaxWidth
+  static unpack_kernel_type Unpack(uint8_t width) {
+    return Get().unpack_[width];
+  }
+
+  static pack_kernel_type Pack(uint8_t width) {
+    return Get().pack_[width];
+  }
+
+ private:
+  BitPackKernels() {
+    unpack_[0] = nullptr;
+    pack_[0] = nullptr;
+    Fill(std::integral_constant<uint8_t, kMaxWidth>());
+  }
+
+  static const BitPackKernels &Get() {
+    static const BitPackKernels kernels;
+    return kernels;
+  }
+
+  void Fill(std::integral_constant<uint8_t, 0>) {}
+
+  template<uint8_t W>
+  void Fill(std::integral_constant<uint8_t, W>) {
+    unpack_[W] = BitPack<T, W>::Unpack;
+    pack_[W] = BitPack<T, W>::Pack;
+    Fill(std::integral_constant<uint8_t, W - 1>());
+  }
+
+  unpack_kernel_type unpack_[kMaxWidth + 1];
+  pack_kernel_type pack_[kMaxWidth + 1];
+};
+
+}
+
+#endif // BITMAP_BIT_PACK_H_
@@ -0,0 +1,183 @@
+#ifndef BITMAP_BIT_STREAM_H_
+#define BITMAP_BIT_STREAM_H_
+
+#include "bit_field.h"
+#include "bit_vector.h"
+#include "utils.h"
+
+namespace bits {
+
+// Sequential writer over a BitVector that accumulates bits in a 64-bit
+// buffer and stores whole blocks. Bits are written starting at the given
+// position; bits before it (within its block) are preserved. The vector
+// must be large enough to hold everything written. Written bits are only
+// guaranteed to be visible after Flush() (or destruction).
+class BitWriter {
+ public:
+  typedef BitVector::pos_type pos_type;
+  typedef BitVector::data_type data_type;
+  typedef BitVector::width_type width_type;
+
+  explicit BitWriter(BitVector &out, pos_type pos = 0) {
+    data_ = out.GetData();
+    idx_ = pos / 64;
+    filled_ = pos % 64;
+    buffer_ = (filled_ != 0) ? (data_[idx_] & low_bits_set[filled_]) : 0;
+  }
+
+  BitWriter(const BitWriter &) = delete;
+  BitWriter &operator=(const BitWriter &) = delete;
+
+  ~BitWriter() {
+    Flush();
+  }
+
+  // Writes the low `bits` bits of val (which must have no higher bits set)
+  void WriteBits(data_type val, width_type bits) {
+    buffer_ |= val << filled_;
+    if (filled_ + bits >= 64) {
+      data_[idx_++] = buffer_;
+      buffer_ = (filled_ != 0) ? (val >> (64 - filled_)) : 0;
+      filled_ = filled_ + bits - 64;
+    } else {
+      filled_ += bits;
+    }
+  }
+
+  // Writes n zero bits followed by a one bit
+  void WriteUnary(pos_type n) {
+    for (; n >= 64; n -= 64) {
+      WriteBits(0, 64);
+    }
+    WriteBits(0, (width_type) n);
+    WriteBits(1, 1);
+  }
+
+  // Stores any buffered bits, preserving the bits that follow them
+  void Flush() {
+    if (filled_ != 0)
+      data_[idx_] = (data_[idx_] & low_bits_unset[filled_]) | buffer_;
+  }
+
+  pos_type GetPosition() const {
+    return idx_ * 64 + filled_;
+  }
+
+ private:
+  data_type *data_;
+  pos_type idx_;        // Block the buffer is flushed to
+  width_type filled_;   // Number of buffered bits
+  data_type buffer_;
+};
+
+// Sequential reader over a BitVector that keeps the unread bits of the
+// current block in a 64-bit buffer, so that consecutive reads do not
+// recompute block indexes and masks. Masks come from the BitFieldImpl
+// policy (see bit_field.h); decoders dispatched on the CPU instantiate the
+// reader with BMI2BitField.
+template<typename BitFieldImpl>
+class BasicBitReader {
+ public:
+  typedef BitVector::pos_type pos_type;
+  typedef BitVector::size_type size_type;
+  typedef BitVector::data_type data_type;
+  typedef BitVector::width_type width_type;
+  typedef BitFieldImpl bit_field_type;
+
+  explicit BasicBitReader(const BitVector &in, pos_type pos = 0) {
+    data_ = in.GetData();
+    num_blocks_ = BITS2BLOCKS(in.GetSizeInBits());
+    Seek(pos);
+  }
+
+  void Seek(pos_type pos) {
+    next_idx_ = pos / 64;
+    pos_type off = pos % 64;
+    buffer_ = LoadBlock(next_idx_++) >> off;
+    avail_ = 64 - off;
+  }
+
+  // Reads `bits` bits (at most 64)
+  data_type ReadBits(width_type bits) {
+    if (bits <= avail_) {
+      data_type val = BitFieldImpl::LowBits(buffer_, bits);
+      buffer_ = (bits == 64) ? 0 : buffer_ >> bits;
+      avail_ -= bits;
+      return val;
+    }
+
+    data_type block = LoadBlock(next_idx_++);
+    data_type val = BitFieldImpl::LowBits(buffer_ | (block << avail_), bits);
+    pos_type consumed = bits - avail_;
+    buffer_ = (consumed == 64) ? 0 : block >> consumed;
+    avail_ = 64 - consumed;
+    return val;
+  }
+
+  // Returns the next `bits` bits (at most 64) without consuming them
+  data_type PeekBits(width_type bits) const {
+    if (bits <= avail_ || avail_ == 64)
+      return BitFieldImpl::LowBits(buffer_, bits);
+    return BitFieldImpl::LowBits(buffer_ | (LoadBlock(next_idx_) << avail_), bits);
+  }
+
+  // Returns the next 64 bits without consuming them; bits past the end of
+  // the vector are zero
+  data_type PeekWord() const {
+    if (avail_ == 64)
+      return buffer_;
+    return buffer_ | (LoadBlock(next_idx_) << avail_);
+  }
+
+  void SkipBits(pos_type n) {
+    if (n < avail_) {
+      buffer_ >>= n;
+      avail_ -= n;
+    } else if (n < avail_ + 64) {
+      n -= avail_;
+      buffer_ = LoadBlock(next_idx_++) >> n;
+      avail_ = 64 - n;
+    } else {
+      Seek(GetPosition() + n);
+    }
+  }
+
+  // Reads zero bits up to and including the next one bit, a block at a time
+  // using a trailing zero count, and returns the number of zero bits; the
+  // vector must contain a one bit at or after the current position.
+  pos_type ReadUnary() {
+    pos_type n = 0;
+    while (buffer_ == 0) {
+      n += avail_;
+      buffer_ = LoadBlock(next_idx_++);
+      avail_ = 64;
+    }
+
+    pos_type zeros = __builtin_ctzll(buffer_);
+    n += zeros;
+    buffer_ = (zeros == 63) ? 0 : buffer_ >> (zeros + 1);
+    avail_ -= zeros + 1;
+    return n;
+  }
+
+  pos_type GetPosition() const {
+    return next_idx_ * 64 - avail_;
+  }
+
+ private:
+  data_type LoadBlock(pos_type idx) const {
+    return (idx < num_blocks_) ? data_[idx] : 0;
+  }
+
+  const data_type *data_;
+  size_type num_blocks_;
+  pos_type next_idx_;   // Next block to load into the buffer
+  pos_type avail_;      // Number of unread bits in the buffer
+  data_type buffer_;
+};
+
+typedef BasicBitReader<BitField> BitReader;
+
+}
+
+#endif // BITMAP_BIT_STREAM_H_
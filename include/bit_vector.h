@@ -1,16 +1,88 @@
 #ifndef BITMAP_BITMAP_H_
 #define BITMAP_BITMAP_H_
 
+#include <algorithm>
 #include <cstdint>
 #include <cassert>
 #include <cstddef>
 #include <cstdlib>
 #include <cstring>
 #include <iostream>
+#include <iterator>
+#include <string>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "allocator.h"
+#include "bit_field.h"
+#include "bit_ops.h"
 #include "utils.h"
 
 namespace bits {
 
+// Forward iterator over the positions of the set bits of a BitVector
+template<typename VectorImpl>
+class set_bit_iterator {
+ public:
+  typedef typename VectorImpl::pos_type pos_type;
+  typedef typename VectorImpl::size_type size_type;
+  typedef typename VectorImpl::data_type data_type;
+
+  typedef ptrdiff_t difference_type;
+  typedef pos_type value_type;
+  typedef const pos_type *pointer;
+  typedef pos_type reference;
+  typedef std::forward_iterator_tag iterator_category;
+
+  set_bit_iterator(const VectorImpl *vec, pos_type block_idx) {
+    vec_ = vec;
+    block_idx_ = block_idx;
+    num_blocks_ = BITS2BLOCKS(vec->GetSizeInBits());
+    block_ = (block_idx_ < num_blocks_) ? vec_->GetBlock(block_idx_) : 0;
+    SkipEmptyBlocks();
+  }
+
+  reference operator*() const {
+    return block_idx_ * 64 + __builtin_ctzll(block_);
+  }
+
+  set_bit_iterator &operator++() {
+    block_ &= block_ - 1;
+    SkipEmptyBlocks();
+    return *this;
+  }
+
+  set_bit_iterator operator++(int) {
+    set_bit_iterator it = *this;
+    ++(*this);
+    return it;
+  }
+
+  bool operator==(const set_bit_iterator &it) const {
+    return block_idx_ == it.block_idx_ && block_ == it.block_;
+  }
+
+  bool operator!=(const set_bit_iterator &it) const {
+    return !(*this == it);
+  }
+
+ private:
+  // The raw last block may hold set bits past the end of the vector, which
+  // GetBlock clears, so a non-zero block can still be empty
+  void SkipEmptyBlocks() {
+    while (block_ == 0 && block_idx_ < num_blocks_) {
+      block_idx_ = BitOps::FindNonZero(vec_->GetData(), block_idx_ + 1, num_blocks_);
+      block_ = (block_idx_ < num_blocks_) ? vec_->GetBlock(block_idx_) : 0;
+    }
+  }
+
+  const VectorImpl *vec_;
+  pos_type block_idx_;
+  size_type num_blocks_;
+  data_type block_;
+};
+
 class BitVector {
  public:
   // Type definitions
@@ -18,17 +90,22 @@ class BitVector {
   typedef size_t size_type;
   typedef uint64_t data_type;
   typedef uint8_t width_type;
+  typedef set_bit_iterator<BitVector> set_iterator;
 
   // Constructors and Destructors
   BitVector() : data_(nullptr), size_(0) {}
 
-  explicit BitVector(size_type num_bits) {
+  explicit BitVector(size_type num_bits, Allocator *allocator = Allocator::Default()) : allocator_(allocator) {
     Init(num_bits);
   }
 
-  BitVector(data_type *data, size_type num_bits) {
+  // Takes ownership of data, which must have been allocated by allocator,
+  // through which the vector frees and reallocates it
+  BitVector(data_type *data, size_type num_bits, Allocator *allocator = Allocator::Default())
+      : allocator_(allocator) {
     data_ = data;
     size_ = num_bits;
+    capacity_ = BITS2BLOCKS(num_bits);
   }
 
   virtual ~BitVector() {
@@ -36,25 +113,51 @@ class BitVector {
   }
 
   void Init(size_type num_bits) {
-    data_ = static_cast<data_type *>(malloc(BITS2BLOCKS(num_bits) * sizeof(data_type)));
+    capacity_ = BITS2BLOCKS(num_bits);
+    data_ = static_cast<data_type *>(allocator_->Allocate(capacity_ * sizeof(data_type)));
     size_ = num_bits;
   }
 
   void Destroy() {
-    if (data_ != nullptr) {
-      free(data_);
+    if (map_base_ != nullptr) {
+      munmap(map_base_, map_size_);
+      map_base_ = nullptr;
+      map_size_ = 0;
+      data_ = nullptr;
+    } else if (data_ != nullptr) {
+      allocator_->Deallocate(data_, capacity_ * sizeof(data_type));
       data_ = nullptr;
     }
     size_ = 0;
+    capacity_ = 0;
   }
 
+  // Resizes the vector; the capacity grows geometrically so that repeated
+  // appends only reallocate a logarithmic number of times.
   void Resize(size_type num_bits) {
+    assert(!IsMapped());
     size_type target = BITS2BLOCKS(num_bits);
-    if (target > BITS2BLOCKS(size_))
-      data_ = static_cast<data_type *>(realloc(data_, target * sizeof(data_type)));
+    if (target > capacity_)
+      Reallocate(std::max(target, 2 * capacity_));
     size_ = num_bits;
   }
 
+  // Ensures that the vector can hold num_bits bits without reallocating
+  void Reserve(size_type num_bits) {
+    assert(!IsMapped());
+    size_type target = BITS2BLOCKS(num_bits);
+    if (target > capacity_)
+      Reallocate(target);
+  }
+
+  // Releases any capacity beyond the current size
+  void ShrinkToFit() {
+    assert(!IsMapped());
+    size_type target = BITS2BLOCKS(size_);
+    if (target < capacity_)
+      Reallocate(target);
+  }
+
   void GrowBy(size_type num_bits) {
     Resize(size_ + num_bits);
   }
@@ -64,10 +167,33 @@ class BitVector {
     return data_;
   }
 
+  const data_type *GetData() const {
+    return data_;
+  }
+
   size_type GetSizeInBits() const {
     return size_;
   }
 
+  size_type GetCapacityInBits() const {
+    return capacity_ * 64;
+  }
+
+  // Whether the bits live in a read-only memory mapped file
+  bool IsMapped() const {
+    return map_base_ != nullptr;
+  }
+
+  Allocator *GetAllocator() const {
+    return allocator_;
+  }
+
+  // Sets the allocator used for the bits; the vector must not hold any storage
+  void SetAllocator(Allocator *allocator) {
+    assert(data_ == nullptr);
+    allocator_ = allocator;
+  }
+
   // Bit operations
   void Clear() {
     memset((void *) data_, 0, BITS2BLOCKS(size_) * sizeof(uint64_t));
@@ -85,6 +211,196 @@ class BitVector {
     return GETBITVAL(data_, i);
   }
 
+  // Number of set bits in positions [begin, end)
+  size_type Count(pos_type begin, pos_type end) const {
+    if (begin >= end)
+      return 0;
+
+    pos_type b_idx = begin / 64, e_idx = (end - 1) / 64;
+    data_type head_mask = low_bits_unset[begin % 64];
+    data_type tail_mask = low_bits_set[(end - 1) % 64 + 1];
+    if (b_idx == e_idx)
+      return Utils::Popcount64bit(data_[b_idx] & head_mask & tail_mask);
+
+    return Utils::Popcount64bit(data_[b_idx] & head_mask)
+        + BitOps::Popcount(data_ + b_idx + 1, e_idx - b_idx - 1)
+        + Utils::Popcount64bit(data_[e_idx] & tail_mask);
+  }
+
+  // Number of set bits in the vector
+  size_type Count() const {
+    return Count(0, size_);
+  }
+
+  // Returns the block at index i, with the bits past the end of the vector cleared
+  data_type GetBlock(pos_type i) const {
+    if (i == size_ / 64)
+      return data_[i] & low_bits_set[size_ % 64];
+    return data_[i];
+  }
+
+  // Position of the first set bit at or after pos, or GetSizeInBits() if there is none
+  pos_type NextSetBit(pos_type pos) const {
+    if (pos >= size_)
+      return size_;
+
+    size_type num_blocks = BITS2BLOCKS(size_);
+    pos_type idx = pos / 64;
+    data_type block = GetBlock(idx) & low_bits_unset[pos % 64];
+    if (block == 0) {
+      idx = BitOps::FindNonZero(data_, idx + 1, num_blocks);
+      if (idx >= num_blocks)
+        return size_;
+      block = GetBlock(idx);
+      if (block == 0)
+        return size_;
+    }
+    return idx * 64 + __builtin_ctzll(block);
+  }
+
+  // Position of the last set bit at or before pos, or GetSizeInBits() if there is none
+  pos_type PrevSetBit(pos_type pos) const {
+    if (size_ == 0)
+      return size_;
+    if (pos >= size_)
+      pos = size_ - 1;
+
+    pos_type idx = pos / 64;
+    data_type block = GetBlock(idx) & low_bits_set[pos % 64 + 1];
+    while (block == 0) {
+      if (idx == 0)
+        return size_;
+      block = data_[--idx];
+    }
+    return idx * 64 + 63 - __builtin_clzll(block);
+  }
+
+  // Invokes f(pos) for the position of every set bit, in increasing order
+  template<typename Function>
+  void ForEachSetBit(Function f) const {
+    size_type num_blocks = BITS2BLOCKS(size_);
+    for (pos_type idx = BitOps::FindNonZero(data_, 0, num_blocks); idx < num_blocks;
+         idx = BitOps::FindNonZero(data_, idx + 1, num_blocks)) {
+      data_type block = GetBlock(idx);
+      while (block != 0) {
+        f(idx * 64 + __builtin_ctzll(block));
+        block &= block - 1;
+      }
+    }
+  }
+
+  set_iterator SetBitsBegin() const {
+    return set_iterator(this, 0);
+  }
+
+  set_iterator SetBitsEnd() const {
+    return set_iterator(this, BITS2BLOCKS(size_));
+  }
+
+  // Atomic bit operations; safe against concurrent writers to other bits of
+  // the same block. Ordering is relaxed, so readers must synchronize with
+  // the writers (e.g. by joining them) before reading.
+  void AtomicSetBit(pos_type i) {
+    __atomic_fetch_or(&data_[i / 64], 1ULL << (i % 64), __ATOMIC_RELAXED);
+  }
+
+  void AtomicUnsetBit(pos_type i) {
+    __atomic_fetch_and(&data_[i / 64], ~(1ULL << (i % 64)), __ATOMIC_RELAXED);
+  }
+
+  // Range operations over bit positions [begin, end)
+  void SetRange(pos_type begin, pos_type end) {
+    FillRange(begin, end, true);
+  }
+
+  void ClearRange(pos_type begin, pos_type end) {
+    FillRange(begin, end, false);
+  }
+
+  // Copies num_bits bits of src starting at src_pos to dst_pos; src may be
+  // this vector, with overlapping ranges.
+  void CopyRange(const BitVector &src, pos_type src_pos, pos_type dst_pos, size_type num_bits) {
+    size_type num_words = num_bits / 64, rem_bits = num_bits % 64;
+    if (src_pos % 64 == 0 && dst_pos % 64 == 0) {
+      data_type rem_val = (rem_bits != 0) ? src.GetValPos(src_pos + num_bits - rem_bits, rem_bits) : 0;
+      memmove(data_ + dst_pos / 64, src.data_ + src_pos / 64, num_words * sizeof(data_type));
+      if (rem_bits != 0)
+        SetValPos(dst_pos + num_bits - rem_bits, rem_val, rem_bits);
+      return;
+    }
+
+    if (&src == this && dst_pos > src_pos && dst_pos < src_pos + num_bits) {
+      // Copy backwards so that the source is read before it is overwritten
+      if (rem_bits != 0)
+        SetValPos(dst_pos + num_bits - rem_bits, src.GetValPos(src_pos + num_bits - rem_bits, rem_bits), rem_bits);
+      for (size_type i = num_words; i-- > 0;) {
+        SetValPos(dst_pos + i * 64, src.GetValPos(src_pos + i * 64, 64), 64);
+      }
+    } else {
+      for (size_type i = 0; i < num_words; i++) {
+        SetValPos(dst_pos + i * 64, src.GetValPos(src_pos + i * 64, 64), 64);
+      }
+      if (rem_bits != 0)
+        SetValPos(dst_pos + num_bits - rem_bits, src.GetValPos(src_pos + num_bits - rem_bits, rem_bits), rem_bits);
+    }
+  }
+
+  // Bulk bitwise operations; operands must have the same size in bits
+  void And(const BitVector &other) {
+    assert(size_ == other.size_);
+    BitOps::And(data_, data_, other.data_, BITS2BLOCKS(size_));
+  }
+
+  void Or(const BitVector &other) {
+    assert(size_ == other.size_);
+    BitOps::Or(data_, data_, other.data_, BITS2BLOCKS(size_));
+  }
+
+  void Xor(const BitVector &other) {
+    assert(size_ == other.size_);
+    BitOps::Xor(data_, data_, other.data_, BITS2BLOCKS(size_));
+  }
+
+  void AndNot(const BitVector &other) {
+    assert(size_ == other.size_);
+    BitOps::AndNot(data_, data_, other.data_, BITS2BLOCKS(size_));
+  }
+
+  void Not() {
+    BitOps::Not(data_, data_, BITS2BLOCKS(size_));
+    ClearTail();
+  }
+
+  static void And(BitVector &out, const BitVector &a, const BitVector &b) {
+    assert(a.size_ == b.size_);
+    out.PrepareOutput(a.size_);
+    BitOps::And(out.data_, a.data_, b.data_, BITS2BLOCKS(a.size_));
+  }
+
+  static void Or(BitVector &out, const BitVector &a, const BitVector &b) {
+    assert(a.size_ == b.size_);
+    out.PrepareOutput(a.size_);
+    BitOps::Or(out.data_, a.data_, b.data_, BITS2BLOCKS(a.size_));
+  }
+
+  static void Xor(BitVector &out, const BitVector &a, const BitVector &b) {
+    assert(a.size_ == b.size_);
+    out.PrepareOutput(a.size_);
+    BitOps::Xor(out.data_, a.data_, b.data_, BITS2BLOCKS(a.size_));
+  }
+
+  static void AndNot(BitVector &out, const BitVector &a, const BitVector &b) {
+    assert(a.size_ == b.size_);
+    out.PrepareOutput(a.size_);
+    BitOps::AndNot(out.data_, a.data_, b.data_, BITS2BLOCKS(a.size_));
+  }
+
+  static void Not(BitVector &out, const BitVector &a) {
+    out.PrepareOutput(a.size_);
+    BitOps::Not(out.data_, a.data_, BITS2BLOCKS(a.size_));
+    out.ClearTail();
+  }
+
   // Integer operations
   void AppendVal(data_type val, width_type bits) {
     pos_type pos = size_;
@@ -93,29 +409,57 @@ class BitVector {
   }
 
   void SetValPos(pos_type pos, data_type val, width_type bits) {
+    SetValPosWith<BitField>(pos, val, bits);
+  }
+
+  // As SetValPos, with the masks of the given bit-field policy (see
+  // bit_field.h), for kernels dispatched on the CPU
+  template<typename BitFieldImpl>
+  void SetValPosWith(pos_type pos, data_type val, width_type bits) {
     pos_type s_off = pos % 64;
     pos_type s_idx = pos / 64;
 
     if (s_off + bits <= 64) {
       // Can be accommodated in 1 bitmap block
-      data_[s_idx] = (data_[s_idx] & (low_bits_set[s_off] | low_bits_unset[s_off + bits])) | val << s_off;
+      data_[s_idx] = BitFieldImpl::Insert(data_[s_idx], val, s_off, bits);
     } else {
       // Must use 2 bitmap blocks
-      data_[s_idx] = (data_[s_idx] & low_bits_set[s_off]) | val << s_off;
-      data_[s_idx + 1] = (data_[s_idx + 1] & low_bits_unset[(s_off + bits) % 64]) | (val >> (64 - s_off));
+      data_[s_idx] = BitFieldImpl::Insert(data_[s_idx], val, s_off, 64 - s_off);
+      data_[s_idx + 1] = BitFieldImpl::Insert(data_[s_idx + 1], val >> (64 - s_off), 0, s_off + bits - 64);
+    }
+  }
+
+  // Atomic variant of SetValPos; safe against concurrent writers to other
+  // fields, including fields that share either block of a field spanning
+  // two blocks. Concurrent writers to the same field may interleave.
+  void AtomicSetValPos(pos_type pos, data_type val, width_type bits) {
+    pos_type s_off = pos % 64;
+    pos_type s_idx = pos / 64;
+
+    if (s_off + bits <= 64) {
+      AtomicReplaceBits(s_idx, low_bits_set[s_off] | low_bits_unset[s_off + bits], val << s_off);
+    } else {
+      AtomicReplaceBits(s_idx, low_bits_set[s_off], val << s_off);
+      AtomicReplaceBits(s_idx + 1, low_bits_unset[(s_off + bits) % 64], val >> (64 - s_off));
     }
   }
 
   data_type GetValPos(pos_type pos, width_type bits) const {
+    return GetValPosWith<BitField>(pos, bits);
+  }
+
+  // As GetValPos, with the masks of the given bit-field policy
+  template<typename BitFieldImpl>
+  data_type GetValPosWith(pos_type pos, width_type bits) const {
     pos_type s_off = pos % 64;
     pos_type s_idx = pos / 64;
 
     if (s_off + bits <= 64) {
       // Can be read from a single block
-      return (data_[s_idx] >> s_off) & low_bits_set[bits];
+      return BitFieldImpl::Extract(data_[s_idx], s_off, bits);
     } else {
       // Must be read from two blocks
-      return ((data_[s_idx] >> s_off) | (data_[s_idx + 1] << (64 - s_off))) & low_bits_set[bits];
+      return BitFieldImpl::LowBits((data_[s_idx] >> s_off) | (data_[s_idx + 1] << (64 - s_off)), bits);
     }
   }
 
@@ -135,20 +479,125 @@ class BitVector {
   virtual size_type Deserialize(std::istream &in) {
     size_t in_size = 0;
 
+    Destroy();
+
     in.read(reinterpret_cast<char *>(&size_), sizeof(size_type));
     in_size += sizeof(size_type);
 
-    data_ = static_cast<data_type *>(malloc(BITS2BLOCKS(size_) * sizeof(data_type)));
+    capacity_ = BITS2BLOCKS(size_);
+    data_ = static_cast<data_type *>(allocator_->Allocate(capacity_ * sizeof(data_type)));
     in.read(reinterpret_cast<char *>(data_), BITS2BLOCKS(size_) * sizeof(data_type));
     in_size += (BITS2BLOCKS(size_) * sizeof(data_type));
 
     return in_size;
   }
 
+  // Maps a serialized BitVector at the given file offset into memory without
+  // copying it; the bits are read-only and are unmapped on Destroy(). The
+  // offset must be 8-byte aligned, so that the blocks are. Returns the
+  // number of bytes consumed (as Deserialize does), or 0 on failure.
+  virtual size_type MemoryMap(const std::string &path, size_type offset = 0) {
+    Destroy();
+    if (offset % sizeof(data_type) != 0)
+      return 0;
+
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+      return 0;
+
+    size_type num_bits;
+    struct stat st{};
+    if (pread(fd, &num_bits, sizeof(size_type), offset) != sizeof(size_type) || fstat(fd, &st) != 0) {
+      close(fd);
+      return 0;
+    }
+
+    size_type in_size = sizeof(size_type) + BITS2BLOCKS(num_bits) * sizeof(data_type);
+    if (offset + in_size > static_cast<size_type>(st.st_size)) {
+      close(fd);
+      return 0;
+    }
+
+    size_type page_size = sysconf(_SC_PAGESIZE);
+    size_type map_offset = offset - offset % page_size;
+    size_type map_size = offset + in_size - map_offset;
+    void *base = mmap(nullptr, map_size, PROT_READ, MAP_SHARED, fd, map_offset);
+    close(fd);
+    if (base == MAP_FAILED)
+      return 0;
+
+    map_base_ = base;
+    map_size_ = map_size;
+    data_ = reinterpret_cast<data_type *>(static_cast<char *>(base) + (offset - map_offset) + sizeof(size_type));
+    size_ = num_bits;
+    capacity_ = BITS2BLOCKS(num_bits);
+
+    return in_size;
+  }
+
+ private:
+  // Atomically replaces the bits of block idx outside keep_mask with bits
+  void AtomicReplaceBits(pos_type idx, data_type keep_mask, data_type bits) {
+    data_type expected = __atomic_load_n(&data_[idx], __ATOMIC_RELAXED);
+    while (!__atomic_compare_exchange_n(&data_[idx], &expected, (expected & keep_mask) | bits, true,
+                                        __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+    }
+  }
+
+  // Moves the bits to an allocation of num_blocks blocks; new blocks are zeroed
+  void Reallocate(size_type num_blocks) {
+    if (num_blocks == 0) {
+      allocator_->Deallocate(data_, capacity_ * sizeof(data_type));
+      data_ = nullptr;
+    } else {
+      data_ = static_cast<data_type *>(allocator_->Reallocate(data_, capacity_ * sizeof(data_type),
+                                                              num_blocks * sizeof(data_type)));
+    }
+    capacity_ = num_blocks;
+  }
+
+  void FillRange(pos_type begin, pos_type end, bool val) {
+    if (begin >= end)
+      return;
+
+    pos_type b_idx = begin / 64, e_idx = (end - 1) / 64;
+    data_type head_mask = low_bits_unset[begin % 64];
+    data_type tail_mask = low_bits_set[(end - 1) % 64 + 1];
+    if (b_idx == e_idx) {
+      head_mask &= tail_mask;
+      data_[b_idx] = val ? (data_[b_idx] | head_mask) : (data_[b_idx] & ~head_mask);
+      return;
+    }
+
+    data_[b_idx] = val ? (data_[b_idx] | head_mask) : (data_[b_idx] & ~head_mask);
+    memset((void *) (data_ + b_idx + 1), val ? 0xFF : 0, (e_idx - b_idx - 1) * sizeof(data_type));
+    data_[e_idx] = val ? (data_[e_idx] | tail_mask) : (data_[e_idx] & ~tail_mask);
+  }
+
+  // Zeroes the unused bits of the last block
+  void ClearTail() {
+    if (size_ % 64 != 0)
+      data_[size_ / 64] &= low_bits_set[size_ % 64];
+  }
+
+  void PrepareOutput(size_type num_bits) {
+    assert(!IsMapped());
+    if (data_ == nullptr || size_ != num_bits) {
+      Destroy();
+      Init(num_bits);
+    }
+  }
+
  protected:
   // Data members
   data_type *data_{};
   size_type size_{};
+  size_type capacity_{};  // In blocks
+  Allocator *allocator_ = Allocator::Default();
+
+  // Memory mapping backing data_, if any
+  void *map_base_{};
+  size_type map_size_{};
 };
 
 }
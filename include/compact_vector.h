@@ -1,9 +1,15 @@
 #ifndef BITMAP_BITMAP_ARRAY_H_
 #define BITMAP_BITMAP_ARRAY_H_
 
+#include "bit_pack.h"
 #include "bit_vector.h"
+#include "search_index.h"
 
+#include <algorithm>
+#include <cstring>
 #include <limits>
+#include <type_traits>
+#include <vector>
 
 namespace bits {
 
@@ -191,7 +197,7 @@ class vector_iterator {
   }
 
   bool operator!=(const vector_iterator &it) const {
-    return *this != it;
+    return it.pos_ != pos_;
   }
 
   bool operator<(const vector_iterator &it) const {
@@ -203,11 +209,11 @@ class vector_iterator {
   }
 
   bool operator>=(const vector_iterator &it) const {
-    return *this >= it;
+    return pos_ >= it.pos_;
   }
 
   bool operator<=(const vector_iterator &it) const {
-    return *this <= it;
+    return pos_ <= it.pos_;
   }
 
   difference_type operator-(const vector_iterator &it) {
@@ -293,7 +299,7 @@ class const_vector_iterator {
   }
 
   bool operator!=(const const_vector_iterator &it) const {
-    return *this != it;
+    return it.pos_ != pos_;
   }
 
   bool operator<(const const_vector_iterator &it) const {
@@ -305,11 +311,11 @@ class const_vector_iterator {
   }
 
   bool operator>=(const const_vector_iterator &it) const {
-    return *this >= it;
+    return pos_ >= it.pos_;
   }
 
   bool operator<=(const const_vector_iterator &it) const {
-    return *this <= it;
+    return pos_ <= it.pos_;
   }
 
   difference_type operator-(const const_vector_iterator &it) {
@@ -321,6 +327,173 @@ class const_vector_iterator {
   pos_type pos_;
 };
 
+// Read-only iterator over the values of a CompactVector that tracks the
+// block and bit offset of the current value, so that stepping through the
+// values needs no multiplication and each value is extracted with at most
+// two block reads.
+template<typename T, uint8_t W>
+class const_compact_iterator {
+ public:
+  typedef uint64_t data_type;
+  typedef size_t pos_type;
+
+  typedef ptrdiff_t difference_type;
+  typedef T value_type;
+  typedef const T *pointer;
+  typedef T reference;
+  typedef std::random_access_iterator_tag iterator_category;
+
+  const_compact_iterator() {
+    data_ = NULL;
+    idx_ = 0;
+    off_ = 0;
+  }
+
+  const_compact_iterator(const data_type *data, pos_type pos) {
+    data_ = data;
+    Seek(pos * W);
+  }
+
+  reference operator*() const {
+    data_type val = data_[idx_] >> off_;
+    if (off_ + W > 64)
+      val |= data_[idx_ + 1] << (64 - off_);
+    return (T) (val & low_bits_set[W]);
+  }
+
+  const_compact_iterator &operator++() {
+    off_ += W;
+    if (off_ >= 64) {
+      off_ -= 64;
+      idx_++;
+    }
+    return *this;
+  }
+
+  const_compact_iterator operator++(int) {
+    const_compact_iterator it = *this;
+    ++(*this);
+    return it;
+  }
+
+  const_compact_iterator &operator--() {
+    if (off_ < W) {
+      off_ += 64;
+      idx_--;
+    }
+    off_ -= W;
+    return *this;
+  }
+
+  const_compact_iterator operator--(int) {
+    const_compact_iterator it = *this;
+    --(*this);
+    return it;
+  }
+
+  const_compact_iterator &operator+=(difference_type i) {
+    Seek(BitPos() + i * W);
+    return *this;
+  }
+
+  const_compact_iterator &operator-=(difference_type i) {
+    Seek(BitPos() - i * W);
+    return *this;
+  }
+
+  const_compact_iterator operator+(difference_type i) const {
+    const_compact_iterator it = *this;
+    return it += i;
+  }
+
+  const_compact_iterator operator-(difference_type i) const {
+    const_compact_iterator it = *this;
+    return it -= i;
+  }
+
+  reference operator[](difference_type i) const {
+    return *(*this + i);
+  }
+
+  bool operator==(const const_compact_iterator &it) const {
+    return it.idx_ == idx_ && it.off_ == off_;
+  }
+
+  bool operator!=(const const_compact_iterator &it) const {
+    return !(*this == it);
+  }
+
+  bool operator<(const const_compact_iterator &it) const {
+    return BitPos() < it.BitPos();
+  }
+
+  bool operator>(const const_compact_iterator &it) const {
+    return BitPos() > it.BitPos();
+  }
+
+  bool operator>=(const const_compact_iterator &it) const {
+    return BitPos() >= it.BitPos();
+  }
+
+  bool operator<=(const const_compact_iterator &it) const {
+    return BitPos() <= it.BitPos();
+  }
+
+  difference_type operator-(const const_compact_iterator &it) const {
+    return ((difference_type) BitPos() - (difference_type) it.BitPos()) / W;
+  }
+
+ private:
+  pos_type BitPos() const {
+    return idx_ * 64 + off_;
+  }
+
+  void Seek(pos_type bit_pos) {
+    idx_ = bit_pos / 64;
+    off_ = bit_pos % 64;
+  }
+
+  const data_type *data_;
+  pos_type idx_;  // Block holding the first bit of the current value
+  pos_type off_;  // Offset of that bit within the block
+};
+
+// Native type of the byte-aligned widths. With the little-endian packing
+// of CompactVector, values of these widths form a plain array of the native
+// type, so they are read and written with ordinary loads and stores; the
+// may_alias attribute allows accessing the 64-bit blocks through it.
+template<uint8_t W>
+struct native_width {
+  static const bool value = false;
+  typedef void type;
+};
+
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+template<>
+struct native_width<8> {
+  static const bool value = true;
+  typedef uint8_t __attribute__((__may_alias__)) type;
+};
+
+template<>
+struct native_width<16> {
+  static const bool value = true;
+  typedef uint16_t __attribute__((__may_alias__)) type;
+};
+
+template<>
+struct native_width<32> {
+  static const bool value = true;
+  typedef uint32_t __attribute__((__may_alias__)) type;
+};
+
+template<>
+struct native_width<64> {
+  static const bool value = true;
+  typedef uint64_t __attribute__((__may_alias__)) type;
+};
+#endif
+
 template<typename T, uint8_t W>
 class CompactVector : public BitVector {
  public:
@@ -336,32 +509,43 @@ class CompactVector : public BitVector {
   typedef ptrdiff_t difference_type;
   typedef T *pointer;
   typedef vector_iterator<CompactVector<T, W>> iterator;
-  typedef const_vector_iterator<CompactVector<T, W>> const_iterator;
+  typedef const_compact_iterator<T, W> const_iterator;
   typedef std::random_access_iterator_tag iterator_category;
 
   // Constructors and destructors
   CompactVector() : BitVector() {}
 
-  CompactVector(const CompactVector &vec) {
-    data_ = vec.data_;
-    size_ = vec.size_;
+  // Copies the elements into storage allocated through the allocator of
+  // vec, so that a copy of a memory-mapped vector owns its elements. The
+  // search index is rebuilt rather than shared.
+  CompactVector(const CompactVector &vec) : BitVector(vec.size_, vec.allocator_) {
+    if (size_ != 0)
+      memcpy(data_, vec.data_, BITS2BLOCKS(size_) * sizeof(data_type));
+    if (vec.search_index_ != nullptr)
+      BuildSearchIndex(vec.search_index_->GetStride());
+  }
+
+  CompactVector &operator=(const CompactVector &vec) {
+    CompactVector copy(vec);
+    swap(copy);
+    return *this;
   }
 
-  explicit CompactVector(size_type num_elements) : BitVector(num_elements * W) {}
+  explicit CompactVector(size_type num_elements, Allocator *allocator = Allocator::Default())
+      : BitVector(num_elements * W, allocator) {}
 
-  ~CompactVector() override = default;
+  ~CompactVector() override {
+    DropSearchIndex();
+  }
 
   CompactVector(T *elements, size_type num_elements) : CompactVector(num_elements) {
-    for (uint64_t i = 0; i < num_elements; i++) {
-      Set(i, elements[i]);
-    }
+    SetRange(0, num_elements, elements);
   }
 
   void Init(T *elements, size_type num_elements) {
+    DropSearchIndex();
     BitVector::Init(num_elements * W);
-    for (uint64_t i = 0; i < num_elements; i++) {
-      Set(i, elements[i]);
-    }
+    SetRange(0, num_elements, elements);
   }
 
   width_type GetBitWidth() const {
@@ -376,21 +560,82 @@ class CompactVector : public BitVector {
     return size_ == 0;
   }
 
-  // Accessors and mutators
+  size_type capacity() const {
+    return GetCapacityInBits() / W;
+  }
+
+  // Ensures that num_elements elements fit without reallocating
+  void Reserve(size_type num_elements) {
+    BitVector::Reserve(num_elements * W);
+  }
+
+  // Accessors and mutators; byte-aligned widths (see native_width) use
+  // plain loads and stores
   void Append(T val) {
-    this->AppendVal(val, W);
+    this->GrowBy(W);
+    Set(size() - 1, val);
   }
 
   void Set(pos_type i, T value) {
-    this->SetValPos(i * W, value, W);
+    Set(i, value, is_native());
+  }
+
+  // Thread-safe against concurrent writers to other elements
+  void AtomicSet(pos_type i, T value) {
+    AtomicSet(i, value, is_native());
   }
 
   T Get(pos_type i) const {
-    return (T) this->GetValPos(i * W, W);
+    return Get(i, is_native());
+  }
+
+  // Reads the elements at positions idx[0..n) into out, prefetching the
+  // blocks of later elements so that their cache misses overlap. With
+  // group_indices, the positions are first bucketed by region of the
+  // vector (a counting sort on their high bits), so that elements that
+  // share cache lines or pages are read together; this pays off when the
+  // positions are dense relative to the size of the vector.
+  void MultiGet(const pos_type *idx, size_type n, T *out, bool group_indices = false) const {
+    static const multi_get_kernel_type kernel = SelectMultiGetKernel();
+    (this->*kernel)(idx, n, out, group_indices);
+  }
+
+  // Reads elements [start, start + count) into out
+  void GetRange(pos_type start, size_type count, T *out) const {
+    assert(start + count <= size());
+    GetRange(start, count, out, is_native());
+  }
+
+  // Writes elements [start, start + count) from in
+  void SetRange(pos_type start, size_type count, const T *in) {
+    assert(start + count <= size());
+    SetRange(start, count, in, is_native());
+  }
+
+  // Builds a cache-friendly search layer over every stride-th element, used
+  // by LowerBound; the elements must be sorted, and the layer must be
+  // rebuilt after they are modified.
+  void BuildSearchIndex(size_type stride = EytzingerIndex<T>::kDefaultStride) {
+    if (search_index_ == nullptr)
+      search_index_ = new EytzingerIndex<T>();
+    search_index_->Build(*this, stride);
   }
 
+  void DropSearchIndex() {
+    delete search_index_;
+    search_index_ = nullptr;
+  }
+
+  bool HasSearchIndex() const {
+    return search_index_ != nullptr;
+  }
+
+  // Position of the last element <= val in the sorted vector (0 if there is none)
   pos_type LowerBound(T val) const {
-    tmp_pos_type sp = 0, ep = size();
+    if (search_index_ != nullptr)
+      return search_index_->LowerBound(*this, val);
+
+    tmp_pos_type sp = 0, ep = size() - 1;
     pos_type m;
     while (sp <= ep) {
       m = (sp + ep) / 2;
@@ -419,29 +664,34 @@ class CompactVector : public BitVector {
   }
 
   const_iterator begin() const {
-    return const_iterator(this, 0);
+    return const_iterator(data_, 0);
   }
 
   const_iterator cbegin() const {
-    return const_iterator(this, 0);
+    return const_iterator(data_, 0);
   }
 
   iterator end() {
-    return iterator(this, this->num_elements_);
+    return iterator(this, size());
   }
 
   const_iterator end() const {
-    return const_iterator(this, this->num_elements_);
+    return const_iterator(data_, size());
   }
 
   const_iterator cend() const {
-    return const_iterator(this, this->num_elements_);
+    return const_iterator(data_, size());
   }
 
-  void swap(const CompactVector<T, W> &other) {
+  void swap(CompactVector<T, W> &other) {
     using std::swap;
     swap(this->data_, other.data_);
     swap(this->size_, other.size_);
+    swap(this->capacity_, other.capacity_);
+    swap(this->map_base_, other.map_base_);
+    swap(this->map_size_, other.map_size_);
+    swap(this->allocator_, other.allocator_);
+    swap(this->search_index_, other.search_index_);
   }
 
   // Serialization and De-serialization
@@ -450,8 +700,145 @@ class CompactVector : public BitVector {
   }
 
   size_type Deserialize(std::istream &in) override {
+    DropSearchIndex();
     return BitVector::Deserialize(in);
   }
+
+  size_type MemoryMap(const std::string &path, size_type offset = 0) override {
+    DropSearchIndex();
+    return BitVector::MemoryMap(path, offset);
+  }
+
+ private:
+  typedef std::integral_constant<bool, native_width<W>::value> is_native;
+  typedef typename native_width<W>::type native_type;
+
+  const native_type *NativeData() const {
+    return reinterpret_cast<const native_type *>(data_);
+  }
+
+  native_type *NativeData() {
+    return reinterpret_cast<native_type *>(data_);
+  }
+
+  T Get(pos_type i, std::true_type) const {
+    return (T) NativeData()[i];
+  }
+
+  T Get(pos_type i, std::false_type) const {
+    return (T) this->GetValPos(i * W, W);
+  }
+
+  template<typename BitFieldImpl>
+  T GetWith(pos_type i, std::true_type) const {
+    return (T) NativeData()[i];
+  }
+
+  template<typename BitFieldImpl>
+  T GetWith(pos_type i, std::false_type) const {
+    return (T) this->template GetValPosWith<BitFieldImpl>(i * W, W);
+  }
+
+  void Set(pos_type i, T value, std::true_type) {
+    NativeData()[i] = (native_type) value;
+  }
+
+  void Set(pos_type i, T value, std::false_type) {
+    this->SetValPos(i * W, value, W);
+  }
+
+  void AtomicSet(pos_type i, T value, std::true_type) {
+    __atomic_store_n(&NativeData()[i], (native_type) value, __ATOMIC_RELAXED);
+  }
+
+  void AtomicSet(pos_type i, T value, std::false_type) {
+    this->AtomicSetValPos(i * W, value, W);
+  }
+
+  void GetRange(pos_type start, size_type count, T *out, std::true_type) const {
+    std::copy(NativeData() + start, NativeData() + start + count, out);
+  }
+
+  void GetRange(pos_type start, size_type count, T *out, std::false_type) const {
+    BitPack<T, W>::Unpack(data_, BITS2BLOCKS(size_), start, count, out);
+  }
+
+  void SetRange(pos_type start, size_type count, const T *in, std::true_type) {
+    std::copy(in, in + count, NativeData() + start);
+  }
+
+  void SetRange(pos_type start, size_type count, const T *in, std::false_type) {
+    BitPack<T, W>::Pack(data_, start, count, in);
+  }
+
+  typedef void (CompactVector::*multi_get_kernel_type)(const pos_type *, size_type, T *, bool) const;
+
+  // MultiGet is instantiated for each bit-field policy (see bit_field.h), and
+  // the BMI2 instantiation is used if the CPU supports it
+  static multi_get_kernel_type SelectMultiGetKernel() {
+#ifdef BITS_X86
+    if (CpuInfo::HasBMI2())
+      return &CompactVector::BMI2MultiGet;
+#endif
+    return &CompactVector::MultiGetImpl<TableBitField>;
+  }
+
+#ifdef BITS_X86
+  BITS_TARGET("bmi,bmi2")
+  void BMI2MultiGet(const pos_type *idx, size_type n, T *out, bool group_indices) const {
+    MultiGetImpl<BMI2BitField>(idx, n, out, group_indices);
+  }
+#endif
+
+  template<typename BitFieldImpl>
+  void MultiGetImpl(const pos_type *idx, size_type n, T *out, bool group_indices) const {
+    if (!group_indices) {
+      for (size_type i = 0; i < n; i++) {
+        if (i + kPrefetchDistance < n)
+          Prefetch(idx[i + kPrefetchDistance]);
+        out[i] = GetWith<BitFieldImpl>(idx[i], is_native());
+      }
+      return;
+    }
+
+    size_type shift = 0;
+    while ((size() >> shift) >= kMaxMultiGetBuckets)
+      shift++;
+    std::vector<size_type> offsets((size() >> shift) + 2, 0);
+    for (size_type i = 0; i < n; i++) {
+      offsets[(idx[i] >> shift) + 1]++;
+    }
+    for (size_type b = 1; b < offsets.size(); b++) {
+      offsets[b] += offsets[b - 1];
+    }
+    std::vector<size_type> order(n);
+    for (size_type i = 0; i < n; i++) {
+      order[offsets[idx[i] >> shift]++] = i;
+    }
+
+    for (size_type i = 0; i < n; i++) {
+      if (i + kPrefetchDistance < n)
+        Prefetch(idx[order[i + kPrefetchDistance]]);
+      out[order[i]] = GetWith<BitFieldImpl>(idx[order[i]], is_native());
+    }
+  }
+
+  // Number of lookups to prefetch ahead in MultiGet
+  static const size_type kPrefetchDistance = 16;
+
+  // Maximum number of regions MultiGet groups positions into
+  static const size_type kMaxMultiGetBuckets = 1ULL << 16;
+
+  // Prefetches the block(s) holding element i
+  void Prefetch(pos_type i) const {
+    pos_type pos = i * W;
+    __builtin_prefetch(data_ + pos / 64);
+    if ((pos % 64) + W > 64)
+      __builtin_prefetch(data_ + pos / 64 + 1);
+  }
+
+  // Not shared by copies
+  EytzingerIndex<T> *search_index_ = nullptr;
 };
 
 class CompactPtrVector : CompactVector<uint64_t, 44> {
@@ -0,0 +1,72 @@
+#ifndef BITMAP_CPU_INFO_H_
+#define BITMAP_CPU_INFO_H_
+
+#if defined(__x86_64__) || defined(__i386__)
+#define BITS_X86 1
+#endif
+
+namespace bits {
+
+// Runtime CPU feature detection, used to pick instruction-set specific
+// kernels once at startup.
+class CpuInfo {
+ public:
+  static bool HasPOPCNT() {
+#ifdef BITS_X86
+    static const bool supported = (__builtin_cpu_init(), __builtin_cpu_supports("popcnt"));
+    return supported;
+#else
+    return false;
+#endif
+  }
+
+  static bool HasSSSE3() {
+#ifdef BITS_X86
+    static const bool supported = (__builtin_cpu_init(), __builtin_cpu_supports("ssse3"));
+    return supported;
+#else
+    return false;
+#endif
+  }
+
+  static bool HasBMI2() {
+#ifdef BITS_X86
+    static const bool supported =
+        (__builtin_cpu_init(), __builtin_cpu_supports("bmi") && __builtin_cpu_supports("bmi2"));
+    return supported;
+#else
+    return false;
+#endif
+  }
+
+  static bool HasAVX2() {
+#ifdef BITS_X86
+    static const bool supported = (__builtin_cpu_init(), __builtin_cpu_supports("avx2"));
+    return supported;
+#else
+    return false;
+#endif
+  }
+
+  static bool HasAVX512F() {
+#ifdef BITS_X86
+    static const bool supported = (__builtin_cpu_init(), __builtin_cpu_supports("avx512f"));
+    return supported;
+#else
+    return false;
+#endif
+  }
+
+  static bool HasAVX512VPOPCNTDQ() {
+#ifdef BITS_X86
+    static const bool supported = (__builtin_cpu_init(), __builtin_cpu_supports("avx512vpopcntdq"));
+    return supported;
+#else
+    return false;
+#endif
+  }
+};
+
+}
+
+#endif // BITMAP_CPU_INFO_H_
@@ -1,58 +1,358 @@
 #ifndef BITMAP_DELTA_ENCODED_ARRAY_H_
 #define BITMAP_DELTA_ENCODED_ARRAY_H_
 
+#include <algorithm>
+#include <iterator>
 #include <vector>
 
+#include "bit_stream.h"
 #include "bit_vector.h"
-#include "compact_vector.h"
+#include "elias_delta_encoder.h"
+#include "elias_gamma_encoder.h"
 #include "elias_gamma_prefix_sum.h"
+#include "golomb_rice_encoder.h"
+#include "search_index.h"
+#include "stream_vbyte_encoder.h"
+#include "vbyte_encoder.h"
 #include "utils.h"
 
 #define USE_PREFIXSUM_TABLE 1
 
 namespace bits {
 
-template<typename T, uint32_t sampling_rate = 128>
+// Sorted values stored as a sample every sampling_rate values, followed by
+// the encoded deltas to the next sampling_rate - 1 values. Every
+// subsampling_rate values within a sample block, a second tier stores the
+// sum of the deltas and the bit offset of the next delta relative to the
+// sample; these fit in a few bits each, so they are stored in as many bits
+// as the largest of them needs. Random access then decodes at most
+// subsampling_rate - 1 deltas.
+//
+// The codec is supplied by the subclass Derived (CRTP), which provides
+// EncodingSize(delta) and EncodeDeltas(deltas, num_deltas), and a reader
+// of its deltas for the generic decoders; these are resolved at compile
+// time, so the encoding and decoding loops are inlined, and there is no
+// virtual table.
+//
+// All the components are stored one after the other in a single BitVector,
+// so that a vector holds a single allocation (or mapping) and a single
+// allocator, and millions of small vectors cost little more than their
+// encoded size:
+//   samples             NumSamples() values of type T, stored natively
+//   delta offsets       bit offset of the deltas of each sample
+//   subsample offsets   bit offset of each subsample, relative to its sample
+//   subsample sums      value of each subsample, relative to its sample
+//   codec data          Derived::CodecDataBits(size()) bits, from a byte
+//                       boundary (e.g. the Stream VByte control bytes)
+//   deltas              from a byte boundary to the end of the storage
+template<typename Derived, typename T, uint32_t sampling_rate, uint32_t subsampling_rate>
 class DeltaEncodedVector {
  public:
+  static_assert(subsampling_rate > 0 && sampling_rate % subsampling_rate == 0,
+                "The subsampling rate must divide the sampling rate.");
+
   typedef size_t size_type;
   typedef size_t pos_type;
   typedef uint8_t width_type;
 
   DeltaEncodedVector() = default;
 
-  virtual ~DeltaEncodedVector() = default;
+  DeltaEncodedVector(const DeltaEncodedVector &) = delete;
+  DeltaEncodedVector &operator=(const DeltaEncodedVector &) = delete;
+
+  size_type size() const {
+    return num_elements_;
+  }
 
-  // Serialization and De-serialization
-  virtual size_type Serialize(std::ostream &out) {
-    size_type out_size = 0;
+  bool empty() const {
+    return num_elements_ == 0;
+  }
 
-    out_size += samples_.Serialize(out);
-    out_size += delta_offsets_.Serialize(out);
-    out_size += deltas_.Serialize(out);
+  // Sets the allocator of the storage; must be called before encoding
+  void SetAllocator(Allocator *allocator) {
+    storage_.SetAllocator(allocator);
+  }
 
-    return out_size;
+  // Whether Find searches the samples through a search index (see
+  // search_index.h); only vectors with at least kMinIndexedSamples samples
+  // have one
+  bool HasSearchIndex() const {
+    return search_index_ != nullptr;
   }
 
-  virtual size_type Deserialize(std::istream &in) {
-    size_type in_size = 0;
+  // Serialization and De-serialization. The storage follows a header of
+  // the number of elements and of the widths of the packed components
+  size_type Serialize(std::ostream &out) {
+    size_type header[2] = {num_elements_, GetWidths()};
+    out.write(reinterpret_cast<const char *>(header), sizeof(header));
+    return sizeof(header) + storage_.Serialize(out);
+  }
 
-    in_size += samples_.Deserialize(in);
-    in_size += delta_offsets_.Deserialize(in);
-    in_size += deltas_.Deserialize(in);
+  size_type Deserialize(std::istream &in) {
+    Destroy();
+    size_type header[2];
+    in.read(reinterpret_cast<char *>(header), sizeof(header));
+    size_type in_size = sizeof(header) + storage_.Deserialize(in);
+    num_elements_ = header[0];
+    SetWidths(header[1]);
+    BuildSearchIndex();
 
     return in_size;
   }
 
+  // Memory maps a serialized vector without copying; see BitVector::MemoryMap.
+  // On failure, returns 0 and leaves the vector empty.
+  size_type MemoryMap(const std::string &path, size_type offset = 0) {
+    Destroy();
+
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+      return 0;
+    size_type header[2];
+    ssize_t read_size = pread(fd, header, sizeof(header), offset);
+    close(fd);
+    if (read_size != sizeof(header))
+      return 0;
+
+    size_type storage_size = storage_.MemoryMap(path, offset + sizeof(header));
+    if (storage_size == 0)
+      return 0;
+    num_elements_ = header[0];
+    SetWidths(header[1]);
+    if (delta_offsets_width_ > 64 || subsample_offsets_width_ > 64 || subsample_sums_width_ > 64
+        || storage_.GetSizeInBits() < DeltasPos()) {
+      Destroy();
+      return 0;
+    }
+    BuildSearchIndex();
+
+    return sizeof(header) + storage_size;
+  }
+
  protected:
-  // Get the encoding size for an delta value
-  virtual width_type EncodingSize(T delta) = 0;
+  static const uint32_t kSubsamplesPerSample = sampling_rate / subsampling_rate - 1;
+
+  // Below this many samples (eight cache lines of them), a binary search
+  // over the samples costs about as many misses as the search index, which
+  // would cost an allocation per vector
+  static const size_type kMinIndexedSamples = 8 * 64 / sizeof(T);
+
+  // Not virtual; subclasses are not deleted through the base class
+  ~DeltaEncodedVector() {
+    DropSearchIndex();
+  }
+
+  Derived &derived() {
+    return static_cast<Derived &>(*this);
+  }
+
+  const Derived &derived() const {
+    return static_cast<const Derived &>(*this);
+  }
+
+  // Size of the codec data of a vector of num_elements elements; codecs
+  // that store data apart from the deltas define their own
+  static size_type CodecDataBits(size_type) {
+    return 0;
+  }
+
+  // Layout of the storage (see above)
+  size_type NumSamples() const {
+    return (num_elements_ + sampling_rate - 1) / sampling_rate;
+  }
+
+  size_type NumSubsamples() const {
+    return (num_elements_ + subsampling_rate - 1) / subsampling_rate - NumSamples();
+  }
+
+  pos_type DeltaOffsetsPos() const {
+    return NumSamples() * std::numeric_limits<T>::digits;
+  }
+
+  pos_type SubsampleOffsetsPos() const {
+    return DeltaOffsetsPos() + NumSamples() * delta_offsets_width_;
+  }
+
+  pos_type SubsampleSumsPos() const {
+    return SubsampleOffsetsPos() + NumSubsamples() * subsample_offsets_width_;
+  }
+
+  pos_type CodecDataPos() const {
+    return ByteAligned(SubsampleSumsPos() + NumSubsamples() * subsample_sums_width_);
+  }
+
+  pos_type DeltasPos() const {
+    return ByteAligned(CodecDataPos() + Derived::CodecDataBits(num_elements_));
+  }
+
+  static pos_type ByteAligned(pos_type pos) {
+    return (pos + 7) & ~7ULL;
+  }
+
+  T GetSample(pos_type i) const {
+    return reinterpret_cast<const T *>(storage_.GetData())[i];
+  }
+
+  pos_type GetDeltaOffset(pos_type i) const {
+    return storage_.GetValPos(DeltaOffsetsPos() + i * delta_offsets_width_, delta_offsets_width_);
+  }
+
+  pos_type GetSubsampleOffset(pos_type i) const {
+    return storage_.GetValPos(SubsampleOffsetsPos() + i * subsample_offsets_width_, subsample_offsets_width_);
+  }
 
-  // Encode the delta values
-  virtual void EncodeDeltas(T *deltas, size_type num_deltas) = 0;
+  T GetSubsampleSum(pos_type i) const {
+    return (T) storage_.GetValPos(SubsampleSumsPos() + i * subsample_sums_width_, subsample_sums_width_);
+  }
+
+  // Position of the last sample <= val (0 if there is none)
+  pos_type SampleLowerBound(T val) const {
+    if (search_index_ != nullptr)
+      return search_index_->LowerBound(SampleVector(this), val);
+
+    const T *samples = reinterpret_cast<const T *>(storage_.GetData());
+    pos_type pos = std::upper_bound(samples, samples + NumSamples(), val) - samples;
+    return (pos == 0) ? 0 : pos - 1;
+  }
+
+  void BuildSearchIndex() {
+    if (NumSamples() < kMinIndexedSamples)
+      return;
+    if (search_index_ == nullptr)
+      search_index_ = new EytzingerIndex<T>();
+    search_index_->Build(SampleVector(this));
+  }
+
+  void DropSearchIndex() {
+    delete search_index_;
+    search_index_ = nullptr;
+  }
+
+  // Releases (or unmaps) the storage and empties the vector
+  void Destroy() {
+    DropSearchIndex();
+    storage_.Destroy();
+    num_elements_ = 0;
+    SetWidths(0);
+  }
+
+  // Index of the sub_idx-th (>= 1) subsample of sample sample_idx
+  static pos_type SubsampleIndex(pos_type sample_idx, pos_type sub_idx) {
+    return sample_idx * kSubsamplesPerSample + sub_idx - 1;
+  }
+
+  // For element i, adds the value of the closest subsample at or before it
+  // (relative to the sample) to *val, sets *delta_idx to the number of
+  // deltas that remain to be decoded and returns the bit offset of the
+  // first of them, relative to the deltas
+  pos_type SeekSubsample(pos_type i, T *val, pos_type *delta_idx) const {
+    pos_type samples_idx = i / sampling_rate;
+    pos_type delta_offset = GetDeltaOffset(samples_idx);
+    *delta_idx = i % sampling_rate;
+    pos_type sub_idx = *delta_idx / subsampling_rate;
+    if (sub_idx != 0) {
+      pos_type subsample_idx = SubsampleIndex(samples_idx, sub_idx);
+      *val += GetSubsampleSum(subsample_idx);
+      delta_offset += GetSubsampleOffset(subsample_idx);
+      *delta_idx %= subsampling_rate;
+    }
+    return delta_offset;
+  }
+
+  // For element val - sample in sample block sample_idx, returns the bit
+  // offset of the deltas after the last subsample of the block whose value
+  // does not exceed it, and sets *delta_idx to the index of that subsample
+  // within the block (0 for the sample) and *delta_sum to its value
+  // relative to the sample
+  pos_type SeekSubsampleBelow(pos_type sample_idx, T val, pos_type *delta_idx, T *delta_sum) const {
+    pos_type delta_offset = GetDeltaOffset(sample_idx);
+    pos_type sub_idx = 0;
+    size_type num_subsamples = NumSubsamples();
+    while (sub_idx < kSubsamplesPerSample && SubsampleIndex(sample_idx, sub_idx + 1) < num_subsamples
+        && GetSubsampleSum(SubsampleIndex(sample_idx, sub_idx + 1)) <= val) {
+      sub_idx++;
+    }
+
+    *delta_idx = 0;
+    *delta_sum = 0;
+    if (sub_idx != 0) {
+      pos_type subsample_idx = SubsampleIndex(sample_idx, sub_idx);
+      *delta_idx = sub_idx * subsampling_rate;
+      *delta_sum = GetSubsampleSum(subsample_idx);
+      delta_offset += GetSubsampleOffset(subsample_idx);
+    }
+    return delta_offset;
+  }
+  // Generic decoding for codecs that decode one delta at a time.
+  // DeltaReader(derived(), sample_idx, delta_idx, delta_offset) reads the
+  // deltas of sample block sample_idx, starting with the delta of element
+  // delta_idx + 1 of the block, at bit offset delta_offset; its Next()
+  // decodes the next delta.
+  template<typename DeltaReader>
+  T GetWith(pos_type i) const {
+    pos_type samples_idx = i / sampling_rate;
+    pos_type num_deltas;
+    T val = GetSample(samples_idx);
+    if (i % sampling_rate == 0)
+      return val;
+
+    pos_type delta_offset = SeekSubsample(i, &val, &num_deltas);
+    DeltaReader reader(derived(), samples_idx, i % sampling_rate - num_deltas, delta_offset);
+    for (; num_deltas != 0; num_deltas--) {
+      val += reader.Next();
+    }
+    return val;
+  }
+
+  template<typename DeltaReader>
+  bool FindWith(T val, pos_type *found_idx) const {
+    pos_type sample_off = SampleLowerBound(val);
+    val -= GetSample(sample_off);
+
+    pos_type delta_idx;
+    T delta_sum;
+    pos_type delta_offset = SeekSubsampleBelow(sample_off, val, &delta_idx, &delta_sum);
+    pos_type block_size = std::min<size_type>(sampling_rate, num_elements_ - sample_off * sampling_rate);
+    DeltaReader reader(derived(), sample_off, delta_idx, delta_offset);
+    while (delta_sum < val && delta_idx + 1 < block_size) {
+      T delta = reader.Next();
+      if (delta_sum + delta > val)
+        break;
+      delta_sum += delta;
+      delta_idx++;
+    }
+
+    if (found_idx)
+      *found_idx = sample_off * sampling_rate + delta_idx;
+    return val == delta_sum;
+  }
+
+  template<typename DeltaReader>
+  void DecodeRangeWith(pos_type start, size_type count, T *out) const {
+    assert(start + count <= num_elements_);
+    pos_type end = start + count;
+    for (pos_type pos = start; pos != end;) {
+      pos_type samples_idx = pos / sampling_rate;
+      pos_type num_deltas = 0;
+      T val = GetSample(samples_idx);
+      pos_type delta_offset = SeekSubsample(pos, &val, &num_deltas);
+      DeltaReader reader(derived(), samples_idx, pos % sampling_rate - num_deltas, delta_offset);
+      for (; num_deltas != 0; num_deltas--) {
+        val += reader.Next();
+      }
+
+      out[pos++ - start] = val;
+      pos_type block_end = std::min<pos_type>(end, (samples_idx + 1) * sampling_rate);
+      for (; pos != block_end; pos++) {
+        val += reader.Next();
+        out[pos - start] = val;
+      }
+    }
+  }
 
   // Encode the delta encoded array
   void Encode(T *elements, size_type num_elements) {
+    num_elements_ = num_elements;
     if (num_elements == 0) {
       return;
     }
@@ -60,8 +360,13 @@ class DeltaEncodedVector {
 #ifdef DEBUG
     assert(std::is_sorted(elements, elements + num_elements));
 #endif
-    std::vector<T> samples, deltas;
-    std::vector<pos_type> delta_offsets;
+    std::vector<T> samples, deltas, subsample_sums;
+    std::vector<pos_type> delta_offsets, subsample_offsets;
+    samples.reserve(num_elements / sampling_rate + 1);
+    delta_offsets.reserve(num_elements / sampling_rate + 1);
+    deltas.reserve(num_elements);
+    subsample_sums.reserve(num_elements / subsampling_rate);
+    subsample_offsets.reserve(num_elements / subsampling_rate);
     T last_val = 0;
     uint64_t tot_delta_count = 0, delta_count = 0;
     uint64_t delta_enc_size;
@@ -81,9 +386,14 @@ class DeltaEncodedVector {
         T delta = elements[i] - last_val;
         deltas.push_back(delta);
 
-        delta_enc_size = EncodingSize(delta);
+        delta_enc_size = derived().EncodingSize(delta);
         cum_delta_size += delta_enc_size;
         delta_count++;
+
+        if (i % subsampling_rate == 0) {
+          subsample_sums.push_back(elements[i] - samples.back());
+          subsample_offsets.push_back(cum_delta_size - delta_offsets.back());
+        }
       }
       last_val = elements[i];
     }
@@ -93,58 +403,114 @@ class DeltaEncodedVector {
     assert(samples.size() + deltas.size() == num_elements);
     assert(delta_offsets.size() == samples.size());
 
-    if (samples.size() != 0) {
-      samples_.Init(&samples[0], samples.size());
-    }
+    delta_offsets_width_ = Utils::BitWidth(cum_delta_size);
+    subsample_offsets_width_ = Utils::BitWidth(
+        subsample_offsets.empty() ? 0 : *std::max_element(subsample_offsets.begin(), subsample_offsets.end()));
+    subsample_sums_width_ = Utils::BitWidth(
+        subsample_sums.empty() ? 0 : *std::max_element(subsample_sums.begin(), subsample_sums.end()));
+    storage_.Init(DeltasPos() + cum_delta_size);
 
-    if (cum_delta_size != 0) {
-      deltas_.Init(cum_delta_size);
-      EncodeDeltas(&deltas[0], deltas.size());
+    std::copy(samples.begin(), samples.end(), reinterpret_cast<T *>(storage_.GetData()));
+    pos_type pos = DeltaOffsetsPos();
+    for (pos_type i = 0; i < delta_offsets.size(); i++, pos += delta_offsets_width_) {
+      storage_.SetValPos(pos, delta_offsets[i], delta_offsets_width_);
     }
-
-    if (!delta_offsets.empty()) {
-      delta_offsets_.Init(&delta_offsets[0], delta_offsets.size());
+    for (pos_type i = 0; i < subsample_offsets.size(); i++, pos += subsample_offsets_width_) {
+      storage_.SetValPos(pos, subsample_offsets[i], subsample_offsets_width_);
+    }
+    for (pos_type i = 0; i < subsample_sums.size(); i++, pos += subsample_sums_width_) {
+      storage_.SetValPos(pos, subsample_sums[i], subsample_sums_width_);
+    }
+    if (!deltas.empty()) {
+      derived().EncodeDeltas(&deltas[0], deltas.size());
     }
+    BuildSearchIndex();
   }
 
-  CompactVector<T, std::numeric_limits<T>::digits> samples_;
-  CompactVector<pos_type, std::numeric_limits<pos_type>::digits> delta_offsets_;
-  BitVector deltas_;
+  BitVector storage_;
+  EytzingerIndex<T> *search_index_ = nullptr;
+  size_type num_elements_ = 0;
+  width_type delta_offsets_width_ = 0;
+  width_type subsample_offsets_width_ = 0;
+  width_type subsample_sums_width_ = 0;
 
  private:
+  // The samples, as the sorted vector the search index is built over
+  class SampleVector {
+   public:
+    explicit SampleVector(const DeltaEncodedVector *vec)
+        : vec_(vec) {
+    }
+
+    size_type size() const {
+      return vec_->NumSamples();
+    }
+
+    T Get(pos_type i) const {
+      return vec_->GetSample(i);
+    }
+
+   private:
+    const DeltaEncodedVector *vec_;
+  };
+
+  // The widths of the packed components, a byte each
+  size_type GetWidths() const {
+    return delta_offsets_width_ | (subsample_offsets_width_ << 8) | (subsample_sums_width_ << 16);
+  }
+
+  void SetWidths(size_type widths) {
+    delta_offsets_width_ = (width_type) widths;
+    subsample_offsets_width_ = (width_type) (widths >> 8);
+    subsample_sums_width_ = (width_type) (widths >> 16);
+  }
 };
 
-template<typename T, uint32_t sampling_rate = 128>
-class EliasGammaDeltaEncodedVector : public DeltaEncodedVector<T, sampling_rate> {
+template<typename Derived, typename T, uint32_t sampling_rate, uint32_t subsampling_rate>
+const uint32_t DeltaEncodedVector<Derived, T, sampling_rate, subsampling_rate>::kSubsamplesPerSample;
+
+template<typename Derived, typename T, uint32_t sampling_rate, uint32_t subsampling_rate>
+const typename DeltaEncodedVector<Derived, T, sampling_rate, subsampling_rate>::size_type
+    DeltaEncodedVector<Derived, T, sampling_rate, subsampling_rate>::kMinIndexedSamples;
+
+template<typename T, uint32_t sampling_rate, uint32_t subsampling_rate>
+class const_elias_gamma_delta_iterator;
+
+template<typename T, uint32_t sampling_rate = 128, uint32_t subsampling_rate = 16>
+class EliasGammaDeltaEncodedVector
+    : public DeltaEncodedVector<EliasGammaDeltaEncodedVector<T, sampling_rate, subsampling_rate>, T, sampling_rate,
+                                subsampling_rate> {
  public:
-  typedef typename DeltaEncodedVector<T>::size_type size_type;
-  typedef typename DeltaEncodedVector<T>::pos_type pos_type;
-  typedef typename DeltaEncodedVector<T>::width_type width_type;
+  typedef DeltaEncodedVector<EliasGammaDeltaEncodedVector, T, sampling_rate, subsampling_rate> base_type;
+  typedef typename base_type::size_type size_type;
+  typedef typename base_type::pos_type pos_type;
+  typedef typename base_type::width_type width_type;
 
-  using DeltaEncodedVector<T>::EncodingSize;
-  using DeltaEncodedVector<T>::EncodeDeltas;
+  typedef const_elias_gamma_delta_iterator<T, sampling_rate, subsampling_rate> const_iterator;
 
   EliasGammaDeltaEncodedVector()
-      : DeltaEncodedVector<T>() {
+      : base_type() {
   }
 
-  EliasGammaDeltaEncodedVector(T *elements, size_type num_elements)
-      : EliasGammaDeltaEncodedVector<T>() {
+  EliasGammaDeltaEncodedVector(T *elements, size_type num_elements, Allocator *allocator = Allocator::Default())
+      : EliasGammaDeltaEncodedVector() {
+    this->SetAllocator(allocator);
     this->Encode(elements, num_elements);
   }
 
-  virtual ~EliasGammaDeltaEncodedVector() = default;
-
   T Get(pos_type i) {
     // Get offsets
     pos_type samples_idx = i / sampling_rate;
     pos_type delta_offsets_idx = i % sampling_rate;
-    T val = this->samples_.Get(samples_idx);
+    T val = this->GetSample(samples_idx);
 
     if (delta_offsets_idx == 0)
       return val;
 
-    pos_type delta_offset = this->delta_offsets_.Get(samples_idx);
+    pos_type delta_offset = this->SeekSubsample(i, &val, &delta_offsets_idx);
+    if (delta_offsets_idx == 0)
+      return val;
+
     val += PrefixSum(delta_offset, delta_offsets_idx);
     return val;
   }
@@ -153,17 +519,118 @@ class EliasGammaDeltaEncodedVector : public DeltaEncodedVector<T, sampling_rate>
     return Get(i);
   }
 
+  // Decodes elements [start, start + count) into out, decoding the deltas
+  // once and in order
+  void DecodeRange(pos_type start, size_type count, T *out) const {
+    assert(start + count <= this->size());
+    static const decode_range_kernel_type kernel = SelectDecodeRangeKernel();
+    (this->*kernel)(start, count, out);
+  }
+
+  // Forward iterators that decode the deltas in order
+  const_iterator begin() const {
+    return const_iterator(this, 0);
+  }
+
+  const_iterator cbegin() const {
+    return const_iterator(this, 0);
+  }
+
+  const_iterator end() const {
+    return const_iterator(this, this->size());
+  }
+
+  const_iterator cend() const {
+    return const_iterator(this, this->size());
+  }
+
   bool Find(T val, pos_type *found_idx = nullptr) {
-    pos_type sample_off = this->samples_.LowerBound(val);
-    pos_type current_delta_offset = this->delta_offsets_.Get(sample_off);
-    val -= this->samples_.Get(sample_off);
+    static const find_kernel_type kernel = SelectFindKernel();
+    return (this->*kernel)(val, found_idx);
+  }
 
-    pos_type delta_idx = 0;
-    T delta_sum = 0;
-    size_type delta_max = this->deltas_.GetSizeInBits();
+ private:
+  friend base_type;
+  friend class const_elias_gamma_delta_iterator<T, sampling_rate, subsampling_rate>;
+
+  typedef bool (EliasGammaDeltaEncodedVector::*find_kernel_type)(T, pos_type *);
+  typedef T (EliasGammaDeltaEncodedVector::*prefix_sum_kernel_type)(pos_type, pos_type);
+  typedef void (EliasGammaDeltaEncodedVector::*decode_range_kernel_type)(pos_type, size_type, T *) const;
+
+  size_type EncodingSize(T delta) {
+    return EliasGammaEncoder<T>::EncodingSize(delta);
+  }
+
+  void EncodeDeltas(T *deltas, size_type num_deltas) {
+    BitWriter writer(this->storage_, this->DeltasPos());
+    for (size_t i = 0; i < num_deltas; i++) {
+      EliasGammaEncoder<T>::Encode(writer, deltas[i]);
+    }
+    writer.Flush();
+  }
+
+  // The decoders are instantiated for each bit-field policy (see
+  // bit_field.h), and the BMI2 instantiation is used if the CPU supports it
+  T PrefixSum(pos_type delta_offset, pos_type until_idx) {
+    static const prefix_sum_kernel_type kernel = SelectPrefixSumKernel();
+    return (this->*kernel)(delta_offset, until_idx);
+  }
+
+  static find_kernel_type SelectFindKernel() {
+#ifdef BITS_X86
+    if (CpuInfo::HasBMI2())
+      return &EliasGammaDeltaEncodedVector::BMI2Find;
+#endif
+    return &EliasGammaDeltaEncodedVector::FindImpl<TableBitField>;
+  }
+
+  static prefix_sum_kernel_type SelectPrefixSumKernel() {
+#ifdef BITS_X86
+    if (CpuInfo::HasBMI2())
+      return &EliasGammaDeltaEncodedVector::BMI2PrefixSum;
+#endif
+    return &EliasGammaDeltaEncodedVector::PrefixSumImpl<TableBitField>;
+  }
+
+  static decode_range_kernel_type SelectDecodeRangeKernel() {
+#ifdef BITS_X86
+    if (CpuInfo::HasBMI2())
+      return &EliasGammaDeltaEncodedVector::BMI2DecodeRange;
+#endif
+    return &EliasGammaDeltaEncodedVector::DecodeRangeImpl<TableBitField>;
+  }
+
+#ifdef BITS_X86
+  BITS_TARGET("bmi,bmi2")
+  bool BMI2Find(T val, pos_type *found_idx) {
+    return FindImpl<BMI2BitField>(val, found_idx);
+  }
+
+  BITS_TARGET("bmi,bmi2")
+  T BMI2PrefixSum(pos_type delta_offset, pos_type until_idx) {
+    return PrefixSumImpl<BMI2BitField>(delta_offset, until_idx);
+  }
+
+  BITS_TARGET("bmi,bmi2")
+  void BMI2DecodeRange(pos_type start, size_type count, T *out) const {
+    DecodeRangeImpl<BMI2BitField>(start, count, out);
+  }
+#endif
 
-    while (delta_sum < val && current_delta_offset < delta_max && delta_idx < sampling_rate) {
-      uint16_t block = this->deltas_.GetValPos(current_delta_offset, 16);
+  template<typename BitFieldImpl>
+  bool FindImpl(T val, pos_type *found_idx) {
+    pos_type sample_off = this->SampleLowerBound(val);
+    val -= this->GetSample(sample_off);
+
+    // Start from the last subsample that does not exceed val
+    pos_type delta_idx;
+    T delta_sum;
+    pos_type current_delta_offset = this->SeekSubsampleBelow(sample_off, val, &delta_idx, &delta_sum);
+    size_type delta_max = this->storage_.GetSizeInBits();
+    BasicBitReader<BitFieldImpl> reader(this->storage_, this->DeltasPos() + current_delta_offset);
+
+    while (delta_sum < val && reader.GetPosition() < delta_max && delta_idx < sampling_rate) {
+      uint16_t block = reader.PeekBits(16);
       uint16_t block_cnt = elias_gamma_prefix_table.count(block);
       uint16_t block_sum = elias_gamma_prefix_table.sum(block);
 
@@ -171,16 +638,8 @@ class EliasGammaDeltaEncodedVector : public DeltaEncodedVector<T, sampling_rate>
         // If the prefixsum table for the block returns count == 0
         // this must mean the value spans more than 16 bits
         // read this manually
-        uint8_t delta_width = 0;
-        while (!this->deltas_.GetBit(current_delta_offset)) {
-          delta_width++;
-          current_delta_offset++;
-        }
-        current_delta_offset++;
-        auto decoded_value = this->deltas_.GetValPos(current_delta_offset, delta_width) + (1ULL << delta_width);
-
+        T decoded_value = EliasGammaEncoder<T>::Decode(reader);
         delta_sum += decoded_value;
-        current_delta_offset += delta_width;
         delta_idx += 1;
 
         // Roll back
@@ -192,22 +651,14 @@ class EliasGammaDeltaEncodedVector : public DeltaEncodedVector<T, sampling_rate>
       } else if (delta_sum + block_sum < val) {
         // If sum can be computed from the prefixsum table
         delta_sum += block_sum;
-        current_delta_offset += elias_gamma_prefix_table.offset(block);
+        reader.SkipBits(elias_gamma_prefix_table.offset(block));
         delta_idx += block_cnt;
       } else {
         // Last few values, decode them without looking up table
         T last_decoded_value = 0;
-        while (delta_sum < val && current_delta_offset < delta_max && delta_idx < sampling_rate) {
-          int delta_width = 0;
-          while (!this->deltas_.GetBit(current_delta_offset)) {
-            delta_width++;
-            current_delta_offset++;
-          }
-          current_delta_offset++;
-          last_decoded_value = this->deltas_.GetValPos(current_delta_offset, delta_width) + (1ULL << delta_width);
-
+        while (delta_sum < val && reader.GetPosition() < delta_max && delta_idx < sampling_rate) {
+          last_decoded_value = EliasGammaEncoder<T>::Decode(reader);
           delta_sum += last_decoded_value;
-          current_delta_offset += delta_width;
           delta_idx += 1;
         }
 
@@ -228,59 +679,66 @@ class EliasGammaDeltaEncodedVector : public DeltaEncodedVector<T, sampling_rate>
     return val == delta_sum;
   }
 
- private:
-  width_type EncodingSize(T delta) override {
-    return 2 * (Utils::BitWidth(delta) - 1) + 1;
+  template<typename BitFieldImpl>
+  T PrefixSumImpl(pos_type delta_offset, pos_type until_idx) {
+    BasicBitReader<BitFieldImpl> reader(this->storage_, this->DeltasPos() + delta_offset);
+    return SumDeltas(reader, until_idx);
   }
 
-  void EncodeDeltas(T *deltas, size_type num_deltas) override {
-    uint64_t pos = 0;
-    for (size_t i = 0; i < num_deltas; i++) {
-      uint64_t delta_bits = Utils::BitWidth(deltas[i]) - 1;
-      pos += delta_bits;
-      assert((1ULL << delta_bits) <= deltas[i]);
-      this->deltas_.SetBit(pos++);
-      this->deltas_.SetValPos(pos, deltas[i] - (1ULL << delta_bits), delta_bits);
-      pos += delta_bits;
+  template<typename BitFieldImpl>
+  void DecodeRangeImpl(pos_type start, size_type count, T *out) const {
+    if (count == 0)
+      return;
+
+    pos_type samples_idx = start / sampling_rate;
+    pos_type delta_idx;
+    T val = this->GetSample(samples_idx);
+    BasicBitReader<BitFieldImpl> reader(this->storage_, this->DeltasPos() + this->SeekSubsample(start, &val, &delta_idx));
+    val += SumDeltas(reader, delta_idx);
+
+    // The deltas of consecutive samples are stored back to back, so the
+    // reader only moves forward
+    pos_type i = start % sampling_rate;
+    pos_type end = start + count;
+    for (pos_type pos = start; pos != end;) {
+      out[pos - start] = val;
+      pos++;
+      pos_type block_end = std::min<pos_type>(end, pos - i + sampling_rate - 1);
+      for (; pos < block_end; pos++) {
+        val += EliasGammaEncoder<T>::Decode(reader);
+        out[pos - start] = val;
+      }
+      if (pos != end) {
+        val = this->GetSample(++samples_idx);
+        i = 0;
+      }
     }
   }
 
-  T PrefixSum(pos_type delta_offset, pos_type until_idx) {
+  // Sums the next until_idx deltas of the reader, skipping whole 16-bit blocks
+  // of codes with the prefix sum table
+  template<typename Reader>
+  static T SumDeltas(Reader &reader, pos_type until_idx) {
     T delta_sum = 0;
     pos_type delta_idx = 0;
-    pos_type current_delta_offset = delta_offset;
     while (delta_idx != until_idx) {
-      uint16_t block = this->deltas_.GetValPos(current_delta_offset, 16);
+      uint16_t block = reader.PeekBits(16);
       uint16_t cnt = elias_gamma_prefix_table.count(block);
       if (cnt == 0) {
         // If the prefixsum table for the block returns count == 0
         // this must mean the value spans more than 16 bits
         // read this manually
-        width_type delta_width = 0;
-        while (!this->deltas_.GetBit(current_delta_offset)) {
-          delta_width++;
-          current_delta_offset++;
-        }
-        current_delta_offset++;
-        delta_sum += this->deltas_.GetValPos(current_delta_offset, delta_width) + (1ULL << delta_width);
-        current_delta_offset += delta_width;
+        delta_sum += EliasGammaEncoder<T>::Decode(reader);
         delta_idx += 1;
       } else if (delta_idx + cnt <= until_idx) {
         // If sum can be computed from the prefixsum table
         delta_sum += elias_gamma_prefix_table.sum(block);
-        current_delta_offset += elias_gamma_prefix_table.offset(block);
+        reader.SkipBits(elias_gamma_prefix_table.offset(block));
         delta_idx += cnt;
       } else {
         // Last few values, decode them without looking up table
         while (delta_idx != until_idx) {
-          width_type delta_width = 0;
-          while (!this->deltas_.GetBit(current_delta_offset)) {
-            delta_width++;
-            current_delta_offset++;
-          }
-          current_delta_offset++;
-          delta_sum += this->deltas_.GetValPos(current_delta_offset, delta_width) + (1ULL << delta_width);
-          current_delta_offset += delta_width;
+          delta_sum += EliasGammaEncoder<T>::Decode(reader);
           delta_idx += 1;
         }
       }
@@ -289,6 +747,493 @@ class EliasGammaDeltaEncodedVector : public DeltaEncodedVector<T, sampling_rate>
   }
 };
 
+// Forward iterator over an EliasGammaDeltaEncodedVector that keeps a reader
+// on the delta stream, so that each step decodes a single delta (or reads a
+// sample) instead of decoding from the sample as Get does.
+template<typename T, uint32_t sampling_rate, uint32_t subsampling_rate>
+class const_elias_gamma_delta_iterator {
+ public:
+  typedef EliasGammaDeltaEncodedVector<T, sampling_rate, subsampling_rate> vector_type;
+  typedef size_t pos_type;
+
+  typedef ptrdiff_t difference_type;
+  typedef T value_type;
+  typedef const T *pointer;
+  typedef T reference;
+  typedef std::forward_iterator_tag iterator_category;
+
+  const_elias_gamma_delta_iterator(const vector_type *array, pos_type pos)
+      : array_(array), reader_(array->storage_), pos_(pos), delta_idx_(0), val_(0) {
+    if (pos_ == array_->size())
+      return;
+
+    val_ = array_->GetSample(pos_ / sampling_rate);
+    reader_.Seek(array_->DeltasPos() + array_->SeekSubsample(pos_, &val_, &delta_idx_));
+    val_ += vector_type::SumDeltas(reader_, delta_idx_);
+    delta_idx_ = pos_ % sampling_rate;
+  }
+
+  reference operator*() const {
+    return val_;
+  }
+
+  const_elias_gamma_delta_iterator &operator++() {
+    if (++pos_ == array_->size())
+      return *this;
+
+    // The deltas of consecutive samples are stored back to back
+    if (++delta_idx_ == sampling_rate) {
+      val_ = array_->GetSample(pos_ / sampling_rate);
+      delta_idx_ = 0;
+    } else {
+      val_ += EliasGammaEncoder<T>::Decode(reader_);
+    }
+    return *this;
+  }
+
+  const_elias_gamma_delta_iterator operator++(int) {
+    const_elias_gamma_delta_iterator it = *this;
+    ++(*this);
+    return it;
+  }
+
+  bool operator==(const const_elias_gamma_delta_iterator &it) const {
+    return it.pos_ == pos_;
+  }
+
+  bool operator!=(const const_elias_gamma_delta_iterator &it) const {
+    return it.pos_ != pos_;
+  }
+
+ private:
+  const vector_type *array_;
+  BitReader reader_;
+  pos_type pos_;
+  pos_type delta_idx_;  // Index of the current element within its sample
+  T val_;
+};
+
+template<typename T, uint32_t sampling_rate = 128, uint32_t subsampling_rate = 16>
+class EliasDeltaDeltaEncodedVector
+    : public DeltaEncodedVector<EliasDeltaDeltaEncodedVector<T, sampling_rate, subsampling_rate>, T, sampling_rate,
+                                subsampling_rate> {
+ public:
+  typedef DeltaEncodedVector<EliasDeltaDeltaEncodedVector, T, sampling_rate, subsampling_rate> base_type;
+  typedef typename base_type::size_type size_type;
+  typedef typename base_type::pos_type pos_type;
+  typedef typename base_type::width_type width_type;
+
+  EliasDeltaDeltaEncodedVector()
+      : base_type() {
+  }
+
+  EliasDeltaDeltaEncodedVector(T *elements, size_type num_elements, Allocator *allocator = Allocator::Default())
+      : EliasDeltaDeltaEncodedVector() {
+    this->SetAllocator(allocator);
+    this->Encode(elements, num_elements);
+  }
+
+  T Get(pos_type i) const {
+    return this->template GetWith<DeltaReader>(i);
+  }
+
+  T operator[](pos_type i) const {
+    return Get(i);
+  }
+
+  bool Find(T val, pos_type *found_idx = nullptr) const {
+    return this->template FindWith<DeltaReader>(val, found_idx);
+  }
+
+  void DecodeRange(pos_type start, size_type count, T *out) const {
+    this->template DecodeRangeWith<DeltaReader>(start, count, out);
+  }
+
+ private:
+  friend base_type;
+
+  class DeltaReader {
+   public:
+    DeltaReader(const EliasDeltaDeltaEncodedVector &vec, pos_type, pos_type, pos_type delta_offset)
+        : reader_(vec.storage_, vec.DeltasPos() + delta_offset) {
+    }
+
+    T Next() {
+      return EliasDeltaEncoder<T>::Decode(reader_);
+    }
+
+   private:
+    BitReader reader_;
+  };
+
+  size_type EncodingSize(T delta) {
+    return EliasDeltaEncoder<T>::EncodingSize(delta);
+  }
+
+  void EncodeDeltas(T *deltas, size_type num_deltas) {
+    BitWriter writer(this->storage_, this->DeltasPos());
+    for (size_t i = 0; i < num_deltas; i++) {
+      EliasDeltaEncoder<T>::Encode(writer, deltas[i]);
+    }
+    writer.Flush();
+  }
+};
+
+// Golomb-Rice coded deltas, with the parameter chosen from the mean delta
+// of the encoded elements
+template<typename T, uint32_t sampling_rate = 128, uint32_t subsampling_rate = 16>
+class GolombRiceDeltaEncodedVector
+    : public DeltaEncodedVector<GolombRiceDeltaEncodedVector<T, sampling_rate, subsampling_rate>, T, sampling_rate,
+                                subsampling_rate> {
+ public:
+  typedef DeltaEncodedVector<GolombRiceDeltaEncodedVector, T, sampling_rate, subsampling_rate> base_type;
+  typedef typename base_type::size_type size_type;
+  typedef typename base_type::pos_type pos_type;
+  typedef typename base_type::width_type width_type;
+
+  GolombRiceDeltaEncodedVector()
+      : base_type(), k_(0) {
+  }
+
+  GolombRiceDeltaEncodedVector(T *elements, size_type num_elements, Allocator *allocator = Allocator::Default())
+      : GolombRiceDeltaEncodedVector() {
+    if (num_elements > 1)
+      k_ = GolombRiceEncoder<T>::ChooseParameter((elements[num_elements - 1] - elements[0]) / (num_elements - 1));
+    this->SetAllocator(allocator);
+    this->Encode(elements, num_elements);
+  }
+
+  width_type GetParameter() const {
+    return k_;
+  }
+
+  T Get(pos_type i) const {
+    return this->template GetWith<DeltaReader>(i);
+  }
+
+  T operator[](pos_type i) const {
+    return Get(i);
+  }
+
+  bool Find(T val, pos_type *found_idx = nullptr) const {
+    return this->template FindWith<DeltaReader>(val, found_idx);
+  }
+
+  void DecodeRange(pos_type start, size_type count, T *out) const {
+    this->template DecodeRangeWith<DeltaReader>(start, count, out);
+  }
+
+  // Serialization and De-serialization; the parameter is stored as a full
+  // word after the deltas, so that everything stays 8-byte aligned
+  size_type Serialize(std::ostream &out) {
+    size_type out_size = base_type::Serialize(out);
+    size_type k = k_;
+    out.write(reinterpret_cast<const char *>(&k), sizeof(size_type));
+    return out_size + sizeof(size_type);
+  }
+
+  size_type Deserialize(std::istream &in) {
+    size_type in_size = base_type::Deserialize(in);
+    size_type k;
+    in.read(reinterpret_cast<char *>(&k), sizeof(size_type));
+    k_ = (width_type) k;
+    return in_size + sizeof(size_type);
+  }
+
+  size_type MemoryMap(const std::string &path, size_type offset = 0) {
+    size_type in_size = base_type::MemoryMap(path, offset);
+    if (in_size == 0)
+      return 0;
+
+    size_type k;
+    ssize_t read_size = -1;
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd >= 0) {
+      read_size = pread(fd, &k, sizeof(size_type), offset + in_size);
+      close(fd);
+    }
+    if (read_size != sizeof(size_type) || k >= std::numeric_limits<T>::digits) {
+      this->Destroy();
+      return 0;
+    }
+    k_ = (width_type) k;
+    return in_size + sizeof(size_type);
+  }
+
+ private:
+  friend base_type;
+
+  class DeltaReader {
+   public:
+    DeltaReader(const GolombRiceDeltaEncodedVector &vec, pos_type, pos_type, pos_type delta_offset)
+        : reader_(vec.storage_, vec.DeltasPos() + delta_offset), k_(vec.k_) {
+    }
+
+    T Next() {
+      return GolombRiceEncoder<T>::Decode(reader_, k_);
+    }
+
+   private:
+    BitReader reader_;
+    width_type k_;
+  };
+
+  size_type EncodingSize(T delta) {
+    return GolombRiceEncoder<T>::EncodingSize(delta, k_);
+  }
+
+  void EncodeDeltas(T *deltas, size_type num_deltas) {
+    BitWriter writer(this->storage_, this->DeltasPos());
+    for (size_t i = 0; i < num_deltas; i++) {
+      GolombRiceEncoder<T>::Encode(writer, deltas[i], k_);
+    }
+    writer.Flush();
+  }
+
+  width_type k_;
+};
+
+// Variable-byte coded deltas. The codes are byte aligned within the bits of
+// the deltas, which are read as bytes (so blocks must be little-endian).
+template<typename T, uint32_t sampling_rate = 128, uint32_t subsampling_rate = 16>
+class VByteDeltaEncodedVector
+    : public DeltaEncodedVector<VByteDeltaEncodedVector<T, sampling_rate, subsampling_rate>, T, sampling_rate,
+                                subsampling_rate> {
+ public:
+  static_assert(__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__, "Bytes are read in little-endian block order.");
+  typedef DeltaEncodedVector<VByteDeltaEncodedVector, T, sampling_rate, subsampling_rate> base_type;
+  typedef typename base_type::size_type size_type;
+  typedef typename base_type::pos_type pos_type;
+  typedef typename base_type::width_type width_type;
+
+  VByteDeltaEncodedVector()
+      : base_type() {
+  }
+
+  VByteDeltaEncodedVector(T *elements, size_type num_elements, Allocator *allocator = Allocator::Default())
+      : VByteDeltaEncodedVector() {
+    this->SetAllocator(allocator);
+    this->Encode(elements, num_elements);
+  }
+
+  T Get(pos_type i) const {
+    return this->template GetWith<DeltaReader>(i);
+  }
+
+  T operator[](pos_type i) const {
+    return Get(i);
+  }
+
+  bool Find(T val, pos_type *found_idx = nullptr) const {
+    return this->template FindWith<DeltaReader>(val, found_idx);
+  }
+
+  void DecodeRange(pos_type start, size_type count, T *out) const {
+    this->template DecodeRangeWith<DeltaReader>(start, count, out);
+  }
+
+ private:
+  friend base_type;
+
+  class DeltaReader {
+   public:
+    DeltaReader(const VByteDeltaEncodedVector &vec, pos_type, pos_type, pos_type delta_offset)
+        : in_(reinterpret_cast<const uint8_t *>(vec.storage_.GetData()) + (vec.DeltasPos() + delta_offset) / 8) {
+    }
+
+    T Next() {
+      return VByteEncoder<T>::Decode(in_);
+    }
+
+   private:
+    const uint8_t *in_;
+  };
+
+  size_type EncodingSize(T delta) {
+    return 8 * VByteEncoder<T>::EncodingSize(delta);
+  }
+
+  void EncodeDeltas(T *deltas, size_type num_deltas) {
+    BitWriter writer(this->storage_, this->DeltasPos());
+    for (size_t i = 0; i < num_deltas; i++) {
+      VByteEncoder<T>::Encode(writer, deltas[i]);
+    }
+    writer.Flush();
+  }
+};
+
+// Stream VByte coded deltas of 32-bit values. The data bytes of the deltas
+// are stored as the deltas of the other codecs; the control bytes are kept
+// apart, in kGroupsPerSample bytes per sample, as the deltas of every
+// sample are grouped separately. DecodeRange decodes whole groups with
+// SSSE3 byte shuffles when the CPU supports it.
+template<typename T, uint32_t sampling_rate = 128, uint32_t subsampling_rate = 16>
+class StreamVByteDeltaEncodedVector
+    : public DeltaEncodedVector<StreamVByteDeltaEncodedVector<T, sampling_rate, subsampling_rate>, T, sampling_rate,
+                                subsampling_rate> {
+ public:
+  static_assert(sampling_rate > 1, "Samples must be followed by deltas.");
+  static_assert(__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__, "Bytes are read in little-endian block order.");
+  typedef DeltaEncodedVector<StreamVByteDeltaEncodedVector, T, sampling_rate, subsampling_rate> base_type;
+  typedef typename base_type::size_type size_type;
+  typedef typename base_type::pos_type pos_type;
+  typedef typename base_type::width_type width_type;
+
+  StreamVByteDeltaEncodedVector()
+      : base_type() {
+  }
+
+  StreamVByteDeltaEncodedVector(T *elements, size_type num_elements, Allocator *allocator = Allocator::Default())
+      : StreamVByteDeltaEncodedVector() {
+    this->SetAllocator(allocator);
+    this->Encode(elements, num_elements);
+  }
+
+  T Get(pos_type i) const {
+    return this->template GetWith<DeltaReader>(i);
+  }
+
+  T operator[](pos_type i) const {
+    return Get(i);
+  }
+
+  bool Find(T val, pos_type *found_idx = nullptr) const {
+    return this->template FindWith<DeltaReader>(val, found_idx);
+  }
+
+  void DecodeRange(pos_type start, size_type count, T *out) const {
+    static const decode_range_kernel_type kernel = SelectDecodeRangeKernel();
+    (this->*kernel)(start, count, out);
+  }
+
+ private:
+  friend base_type;
+
+  typedef void (StreamVByteDeltaEncodedVector::*decode_range_kernel_type)(pos_type, size_type, T *) const;
+
+  static const size_type kGroupsPerSample = (sampling_rate + 2) / 4;
+
+  class DeltaReader {
+   public:
+    DeltaReader(const StreamVByteDeltaEncodedVector &vec, pos_type sample_idx, pos_type delta_idx,
+                pos_type delta_offset)
+        : controls_(reinterpret_cast<const uint8_t *>(vec.storage_.GetData()) + vec.CodecDataPos() / 8
+                        + sample_idx * kGroupsPerSample),
+          in_(reinterpret_cast<const uint8_t *>(vec.storage_.GetData()) + (vec.DeltasPos() + delta_offset) / 8),
+          delta_idx_(delta_idx) {
+    }
+
+    T Next() {
+      width_type length = StreamVByteEncoder<T>::Length(controls_[delta_idx_ / 4], delta_idx_ % 4);
+      delta_idx_++;
+      return StreamVByteEncoder<T>::Decode(in_, length);
+    }
+
+#ifdef BITS_X86
+    bool AtGroup() const {
+      return delta_idx_ % 4 == 0;
+    }
+
+    // Whether the 16 bytes a group decode reads are within in_end
+    bool CanReadGroup(const uint8_t *in_end) const {
+      return in_ + 16 <= in_end;
+    }
+
+    // Decodes the next (full) group, as StreamVByteEncoder::DecodePrefixSums
+    BITS_TARGET("ssse3")
+    void NextGroup(T *prev, T *out) {
+      in_ = StreamVByteEncoder<T>::DecodePrefixSums(in_, controls_[delta_idx_ / 4], prev, out);
+      delta_idx_ += 4;
+    }
+#endif
+
+   private:
+    const uint8_t *controls_;
+    const uint8_t *in_;
+    pos_type delta_idx_;  // Index of the next delta within the sample
+  };
+
+  // The control bytes, kGroupsPerSample for every sample followed by deltas
+  static size_type CodecDataBits(size_type num_elements) {
+    size_type num_deltas = num_elements - (num_elements + sampling_rate - 1) / sampling_rate;
+    return (num_deltas + sampling_rate - 2) / (sampling_rate - 1) * kGroupsPerSample * 8;
+  }
+
+  size_type EncodingSize(T delta) {
+    return 8 * StreamVByteEncoder<T>::EncodingSize(delta);
+  }
+
+  void EncodeDeltas(T *deltas, size_type num_deltas) {
+    BitWriter writer(this->storage_, this->DeltasPos());
+    for (size_t i = 0; i < num_deltas; i++) {
+      StreamVByteEncoder<T>::Encode(writer, deltas[i]);
+    }
+    writer.Flush();
+
+    // Every sample but the last is followed by sampling_rate - 1 deltas
+    size_type num_samples = (num_deltas + sampling_rate - 2) / (sampling_rate - 1);
+    for (pos_type sample_idx = 0; sample_idx < num_samples; sample_idx++) {
+      pos_type first = sample_idx * (sampling_rate - 1);
+      size_type sample_deltas = std::min<size_type>(sampling_rate - 1, num_deltas - first);
+      for (pos_type j = 0; j < sample_deltas; j += 4) {
+        uint8_t control = StreamVByteEncoder<T>::Control(&deltas[first + j], std::min<size_type>(4, sample_deltas - j));
+        this->storage_.SetValPos(this->CodecDataPos() + (sample_idx * kGroupsPerSample + j / 4) * 8, control, 8);
+      }
+    }
+  }
+
+  static decode_range_kernel_type SelectDecodeRangeKernel() {
+#ifdef BITS_X86
+    if (CpuInfo::HasSSSE3())
+      return &StreamVByteDeltaEncodedVector::SSSE3DecodeRange;
+#endif
+    return &StreamVByteDeltaEncodedVector::ScalarDecodeRange;
+  }
+
+  void ScalarDecodeRange(pos_type start, size_type count, T *out) const {
+    this->template DecodeRangeWith<DeltaReader>(start, count, out);
+  }
+
+#ifdef BITS_X86
+  // As DecodeRangeWith, but decodes whole groups of deltas at a time
+  BITS_TARGET("ssse3")
+  void SSSE3DecodeRange(pos_type start, size_type count, T *out) const {
+    assert(start + count <= this->size());
+    const uint8_t *in_end = reinterpret_cast<const uint8_t *>(this->storage_.GetData())
+        + BITS2BLOCKS(this->storage_.GetSizeInBits()) * sizeof(uint64_t);
+    pos_type end = start + count;
+    for (pos_type pos = start; pos != end;) {
+      pos_type samples_idx = pos / sampling_rate;
+      pos_type num_deltas = 0;
+      T val = this->GetSample(samples_idx);
+      pos_type delta_offset = this->SeekSubsample(pos, &val, &num_deltas);
+      DeltaReader reader(*this, samples_idx, pos % sampling_rate - num_deltas, delta_offset);
+      for (; num_deltas != 0; num_deltas--) {
+        val += reader.Next();
+      }
+
+      out[pos++ - start] = val;
+      pos_type block_end = std::min<pos_type>(end, (samples_idx + 1) * sampling_rate);
+      for (; pos != block_end && !reader.AtGroup(); pos++) {
+        val += reader.Next();
+        out[pos - start] = val;
+      }
+      for (; block_end - pos >= 4 && reader.CanReadGroup(in_end); pos += 4) {
+        reader.NextGroup(&val, &out[pos - start]);
+      }
+      for (; pos != block_end; pos++) {
+        val += reader.Next();
+        out[pos - start] = val;
+      }
+    }
+  }
+#endif
+};
+
+template<typename T, uint32_t sampling_rate, uint32_t subsampling_rate>
+const typename StreamVByteDeltaEncodedVector<T, sampling_rate, subsampling_rate>::size_type
+    StreamVByteDeltaEncodedVector<T, sampling_rate, subsampling_rate>::kGroupsPerSample;
+
 }
 
 #endif // BITMAP_DELTA_ENCODED_ARRAY_H_
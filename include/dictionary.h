@@ -1,10 +1,12 @@
 #ifndef BITMAP_DICTIONARY_H_
 #define BITMAP_DICTIONARY_H_
 
+#include <vector>
+
 #include "bit_vector.h"
 #include "utils.h"
 
-namespace bitmap {
+namespace bits {
 
 static const uint32_t kCacheLineSize = 64;
 static const uint64_t kL1BlockSize = 512ULL;
@@ -13,94 +15,316 @@ static const uint64_t kL3BlockSize = 4294967296ULL;
 static const uint64_t kL1BlocksPerL2Block = 4ULL;
 static const uint64_t kL1BlocksPerL3Block = 8388608ULL;
 static const uint64_t kL2BlocksPerL3Block = 2097152ULL;
+static const uint64_t kWordsPerL1Block = kL1BlockSize / 64;
+static const uint64_t kWordsPerL2Block = kL2BlockSize / 64;
+static const uint64_t kSelectSampleRate = 8192ULL;
 
 // Rank and select data structures based on "Poppy"
 // "Space-Efficient, High-Performance Rank & Select Structures
 // on Uncompressed Bit Sequences", Zhou et. al.
-class Dictionary : public Bitmap {
+//
+// The index has three levels:
+//  - L3: one 64-bit cumulative count per 2^32 bits.
+//  - L2: one 64-bit entry per 2048 bits; the low 32 bits hold the
+//    cumulative count relative to the enclosing L3 block, and the next
+//    three 10-bit fields hold the counts of the first three 512-bit L1
+//    blocks within the L2 block.
+//  - L1: counted on the fly within a 512-bit (cache-line) block.
+//
+// Select samples the L2 block holding every kSelectSampleRate-th set (or
+// unset) bit, stored as 32-bit offsets relative to the enclosing L3 block.
+class Dictionary : public BitVector {
  public:
   typedef uint64_t count_type;
-  Dictionary() {
-    rank_l12_ = NULL;
-    rank_l3_ = NULL;
-    pos_l12_ = NULL;
-    pos_l3_ = NULL;
+
+  Dictionary() : BitVector() {
+    rank_l12_ = nullptr;
+    rank_l3_ = nullptr;
+    pos_l12_ = nullptr;
+    pos_l3_ = nullptr;
+    pos0_l12_ = nullptr;
+    pos0_l3_ = nullptr;
   }
 
-  Dictionary(Bitmap& bitmap) {
-    size_type l3_size = L3Size(bitmap.GetSizeInBits());
-    size_type l2_size = L2Size(bitmap.GetSizeInBits());
+  explicit Dictionary(const BitVector &bitmap) : Dictionary() {
+    Init(bitmap);
+  }
 
-    // Allocate rank data structures
-    rank_l3_ = new data_type[l3_size];
-    rank_l12_ = new data_type[l2_size];
+  Dictionary(const Dictionary &) = delete;
+  Dictionary &operator=(const Dictionary &) = delete;
 
-    count_type l3_pop_count = 0;
-    pos_type l2_id = 0, l1_id = 0;
-    for (size_type i = 0; i < l3_size; i++) {
-      rank_l3_[i] = l3_pop_count;
-
-      count_type l2_pop_count = 0;
-      for (uint64_t l2_idx = 0; l2_idx < kL2BlocksPerL3Block; l2_idx++) {
-        rank_l12_[i] = l2_pop_count;
-        count_type l1_pop_count;
-        for (size_type l2_offset = 0; l2_offset < 30; l2_offset++) {
-          l1_pop_count = Utils::Popcount512bit(bitmap.GetData() + (l1_id * 8));
-          l2_pop_count += l1_pop_count;
-          l1_id++;
-          rank_l12_[i] |= ((uint64_t) l1_pop_count) << (32 + l2_offset);
-        }
-        l1_pop_count = Utils::Popcount512bit(bitmap.GetData() + (l1_id * 8));
-        l2_pop_count += l1_pop_count;
-        l1_id++;
-        l2_id++;
-        if (l2_id >= l2_size)
-          break;
-      }
-      l3_pop_count += l2_pop_count;
+  ~Dictionary() override {
+    DestroyIndex();
+  }
+
+  // Copies the bits of the bitmap and builds the rank index over them
+  void Init(const BitVector &bitmap) {
+    Destroy();
+    DestroyIndex();
+
+    size_ = bitmap.GetSizeInBits();
+
+    // Pad the bits to a whole number of L2 blocks (plus one, so that
+    // rank1(GetSizeInBits()) is always defined); the padding is zeroed.
+    size_type num_blocks = BITS2BLOCKS(size_);
+    size_type padded_blocks = NumL2Blocks(size_) * kWordsPerL2Block;
+    data_ = static_cast<data_type *>(allocator_->Allocate(padded_blocks * sizeof(data_type)));
+    capacity_ = padded_blocks;
+    if (num_blocks != 0) {
+      memcpy(data_, bitmap.GetData(), num_blocks * sizeof(data_type));
+      if (size_ % 64 != 0)
+        data_[num_blocks - 1] &= low_bits_set[size_ % 64];
     }
+
+    BuildRankIndex();
+    BuildSelectIndex<true>(&pos_l12_, &pos_l3_);
+    BuildSelectIndex<false>(&pos0_l12_, &pos0_l3_);
   }
 
-  count_type rank1(pos_type i) {
+  // Number of set bits in positions [0, i), for 0 <= i <= GetSizeInBits()
+  count_type rank1(pos_type i) const {
     pos_type l3_id = i >> 32;
     pos_type l2_id = i >> 11;
     pos_type l1_id = (i & 0x7FF) >> 9;
 
     // Compute L3 & L2 ranks
-    count_type rank_value = rank_l3_[l3_id]
-        + (rank_l12_[l2_id] & low_bits_set[32]);
+    data_type l12_entry = rank_l12_[l2_id];
+    count_type rank_value = rank_l3_[l3_id] + (l12_entry & low_bits_set[32]);
 
     // Compute L1 rank
-    count_type l1_values = rank_l12_[l2_id] >> 32;
-    for (uint64_t i = 0; i < l1_id; i++) {
+    count_type l1_values = l12_entry >> 32;
+    for (uint64_t j = 0; j < l1_id; j++) {
       rank_value += l1_values & 0x3FF;
       l1_values >>= 10;
     }
 
     // Compute rank within L1 block
-    // TODO:
+    const data_type *block = data_ + (i >> 9) * kWordsPerL1Block;
+    pos_type word_id = (i & 0x1FF) >> 6;
+    for (uint64_t j = 0; j < word_id; j++) {
+      rank_value += Utils::Popcount64bit(block[j]);
+    }
+    rank_value += Utils::Popcount64bit(BitField::LowBits(block[word_id], i & 0x3F));
 
     return rank_value;
   }
 
-  count_type rank0(pos_type i) {
-    return i - rank1(i) - 1;
+  // Number of unset bits in positions [0, i), for 0 <= i <= GetSizeInBits()
+  count_type rank0(pos_type i) const {
+    return i - rank1(i);
+  }
+
+  // Position of the k-th (0-indexed) set bit; requires k < rank1(GetSizeInBits())
+  pos_type select1(count_type k) const {
+    static const select_kernel_type kernel = SelectSelectKernel<true>();
+    return (this->*kernel)(k, pos_l12_, pos_l3_);
+  }
+
+  // Position of the k-th (0-indexed) unset bit; requires k < rank0(GetSizeInBits())
+  pos_type select0(count_type k) const {
+    static const select_kernel_type kernel = SelectSelectKernel<false>();
+    return (this->*kernel)(k, pos0_l12_, pos0_l3_);
+  }
+
+  // Serialization/De-serialization
+  size_type Serialize(std::ostream &out) override {
+    return BitVector::Serialize(out);
+  }
+
+  size_type Deserialize(std::istream &in) override {
+    BitVector bitmap;
+    size_type in_size = bitmap.Deserialize(in);
+    Init(bitmap);
+    return in_size;
+  }
+
+  // The rank/select index needs zero-padded bits, so the mapped bits are
+  // copied rather than used in place.
+  size_type MemoryMap(const std::string &path, size_type offset = 0) override {
+    BitVector bitmap;
+    size_type in_size = bitmap.MemoryMap(path, offset);
+    Init(bitmap);
+    return in_size;
   }
 
  private:
-  size_type L3Size(size_type bitmap_size) {
-    return (bitmap_size <= kL3BlockSize) ? 1 : bitmap_size >> 32;
+  typedef pos_type (Dictionary::*select_kernel_type)(count_type, const uint32_t *, const data_type *) const;
+
+  // The bit within the final word is found with PDEP if the CPU supports it
+  template<bool bit>
+  static select_kernel_type SelectSelectKernel() {
+#ifdef BITS_X86
+    if (CpuInfo::HasBMI2())
+      return &Dictionary::BMI2Select<bit>;
+#endif
+    return &Dictionary::Select<bit, TableBitField>;
+  }
+
+#ifdef BITS_X86
+  template<bool bit>
+  BITS_TARGET("bmi,bmi2")
+  pos_type BMI2Select(count_type k, const uint32_t *pos_l12, const data_type *pos_l3) const {
+    return Select<bit, BMI2BitField>(k, pos_l12, pos_l3);
+  }
+#endif
+
+  static size_type L3Size(size_type bitmap_size) {
+    return (bitmap_size >> 32) + 1;
+  }
+
+  static size_type NumL2Blocks(size_type bitmap_size) {
+    return (bitmap_size >> 11) + 1;
+  }
+
+  void BuildRankIndex() {
+    size_type l3_size = L3Size(size_);
+    size_type l2_size = NumL2Blocks(size_);
+
+    // Allocate rank data structures
+    rank_l3_ = new data_type[l3_size];
+    rank_l12_ = new data_type[l2_size];
+
+    count_type total_pop_count = 0, l3_pop_count = 0;
+    for (pos_type l2_id = 0; l2_id < l2_size; l2_id++) {
+      if (l2_id % kL2BlocksPerL3Block == 0) {
+        l3_pop_count = total_pop_count;
+        rank_l3_[l2_id / kL2BlocksPerL3Block] = l3_pop_count;
+      }
+
+      data_type l12_entry = total_pop_count - l3_pop_count;
+      uint16_t l1_pop_counts[kL1BlocksPerL2Block];
+      BitOps::Popcount512bit(data_ + l2_id * kWordsPerL2Block, kL1BlocksPerL2Block, l1_pop_counts);
+      for (uint64_t l1_offset = 0; l1_offset < kL1BlocksPerL2Block; l1_offset++) {
+        count_type l1_pop_count = l1_pop_counts[l1_offset];
+        if (l1_offset < kL1BlocksPerL2Block - 1)
+          l12_entry |= l1_pop_count << (32 + 10 * l1_offset);
+        total_pop_count += l1_pop_count;
+      }
+      rank_l12_[l2_id] = l12_entry;
+    }
+  }
+
+  // Number of bits with value `bit` before the L3 block
+  template<bool bit>
+  count_type L3Rank(pos_type l3_id) const {
+    return bit ? rank_l3_[l3_id] : (l3_id << 32) - rank_l3_[l3_id];
+  }
+
+  // Number of bits with value `bit` before the L2 block, relative to its L3 block
+  template<bool bit>
+  count_type L2Rank(pos_type l2_id) const {
+    count_type rank = rank_l12_[l2_id] & low_bits_set[32];
+    return bit ? rank : ((l2_id % kL2BlocksPerL3Block) << 11) - rank;
+  }
+
+  template<bool bit>
+  static data_type Word(data_type word) {
+    return bit ? word : ~word;
+  }
+
+  template<bool bit>
+  void BuildSelectIndex(uint32_t **pos_l12, data_type **pos_l3) {
+    size_type l3_size = L3Size(size_);
+    size_type l2_size = NumL2Blocks(size_);
+
+    std::vector<uint32_t> samples;
+    *pos_l3 = new data_type[l3_size + 1];
+    for (pos_type l3_id = 0; l3_id < l3_size; l3_id++) {
+      (*pos_l3)[l3_id] = samples.size();
+
+      pos_type l2_begin = l3_id * kL2BlocksPerL3Block;
+      pos_type l2_end = std::min(l2_begin + kL2BlocksPerL3Block, l2_size);
+      count_type next_sample = 0;
+      for (pos_type l2_id = l2_begin; l2_id < l2_end; l2_id++) {
+        count_type l2_count = BitOps::Popcount(data_ + l2_id * kWordsPerL2Block, kWordsPerL2Block);
+        count_type l2_end_rank = L2Rank<bit>(l2_id) + (bit ? l2_count : kL2BlockSize - l2_count);
+        while (next_sample < l2_end_rank) {
+          samples.push_back(static_cast<uint32_t>(l2_id - l2_begin));
+          next_sample += kSelectSampleRate;
+        }
+      }
+    }
+    (*pos_l3)[l3_size] = samples.size();
+
+    *pos_l12 = new uint32_t[samples.size() + 1];
+    std::copy(samples.begin(), samples.end(), *pos_l12);
   }
 
-  size_type L2Size(size_type bitmap_size) {
-    return bitmap_size >> 11;
+  template<bool bit, typename BitFieldImpl>
+  pos_type Select(count_type k, const uint32_t *pos_l12, const data_type *pos_l3) const {
+    // Find the L3 block
+    pos_type l3_id = 0;
+    size_type l3_size = L3Size(size_);
+    while (l3_id + 1 < l3_size && L3Rank<bit>(l3_id + 1) <= k)
+      l3_id++;
+    k -= L3Rank<bit>(l3_id);
+
+    // Narrow down to the L2 block using the samples and the rank counters
+    pos_type l2_base = l3_id * kL2BlocksPerL3Block;
+    pos_type sample_id = pos_l3[l3_id] + k / kSelectSampleRate;
+    pos_type lo = l2_base + pos_l12[sample_id];
+    pos_type hi;
+    if (sample_id + 1 < pos_l3[l3_id + 1]) {
+      hi = l2_base + pos_l12[sample_id + 1];
+    } else {
+      hi = std::min(l2_base + kL2BlocksPerL3Block, NumL2Blocks(size_)) - 1;
+    }
+    while (lo < hi) {
+      pos_type mid = lo + (hi - lo + 1) / 2;
+      if (L2Rank<bit>(mid) <= k)
+        lo = mid;
+      else
+        hi = mid - 1;
+    }
+    k -= L2Rank<bit>(lo);
+
+    // Find the L1 block
+    pos_type l1_id = 0;
+    count_type l1_values = rank_l12_[lo] >> 32;
+    for (; l1_id < kL1BlocksPerL2Block - 1; l1_id++) {
+      count_type l1_count = l1_values & 0x3FF;
+      l1_count = bit ? l1_count : kL1BlockSize - l1_count;
+      if (k < l1_count)
+        break;
+      k -= l1_count;
+      l1_values >>= 10;
+    }
+
+    // Find the word within the L1 block, and the bit within the word
+    pos_type word_id = lo * kWordsPerL2Block + l1_id * kWordsPerL1Block;
+    count_type word_count = Utils::Popcount64bit(Word<bit>(data_[word_id]));
+    while (k >= word_count) {
+      k -= word_count;
+      word_count = Utils::Popcount64bit(Word<bit>(data_[++word_id]));
+    }
+
+    return (word_id << 6) + BitFieldImpl::SelectInWord(Word<bit>(data_[word_id]), (uint8_t) k);
+  }
+
+  void DestroyIndex() {
+    delete[] rank_l12_;
+    delete[] rank_l3_;
+    delete[] pos_l12_;
+    delete[] pos_l3_;
+    delete[] pos0_l12_;
+    delete[] pos0_l3_;
+    rank_l12_ = nullptr;
+    rank_l3_ = nullptr;
+    pos_l12_ = nullptr;
+    pos_l3_ = nullptr;
+    pos0_l12_ = nullptr;
+    pos0_l3_ = nullptr;
   }
 
   // Rank data-structures
-  data_type* rank_l12_;
-  data_type* rank_l3_;
-  data_type* pos_l12_;
-  data_type* pos_l3_;
+  data_type *rank_l12_;
+  data_type *rank_l3_;
+
+  // Select data-structures (set bits, unset bits)
+  uint32_t *pos_l12_;
+  data_type *pos_l3_;
+  uint32_t *pos0_l12_;
+  data_type *pos0_l3_;
 };
 
 }
@@ -0,0 +1,198 @@
+#ifndef BITMAP_DYNAMIC_COMPACT_VECTOR_H_
+#define BITMAP_DYNAMIC_COMPACT_VECTOR_H_
+
+#include "bit_pack.h"
+#include "bit_vector.h"
+#include "utils.h"
+
+#include <limits>
+
+namespace bits {
+
+// Compact vector whose bit width is chosen at runtime, either explicitly or
+// as the width of the largest value it is built from. Set and Append widen
+// the vector (repacking every value) when a value does not fit the current
+// width. Bulk range operations dispatch to the BitPack kernels specialized
+// for the current width (see BitPackKernels).
+template<typename T>
+class DynamicCompactVector : public BitVector {
+ public:
+  static_assert(!std::numeric_limits<T>::is_signed, "Signed types cannot be used.");
+  // Type definitions
+  typedef typename BitVector::size_type size_type;
+  typedef typename BitVector::width_type width_type;
+  typedef typename BitVector::pos_type pos_type;
+  typedef typename BitVector::data_type data_type;
+  typedef T value_type;
+
+  // Constructors and destructors
+  DynamicCompactVector() : BitVector(), width_(1) {}
+
+  DynamicCompactVector(size_type num_elements, width_type width, Allocator *allocator = Allocator::Default())
+      : BitVector(num_elements * width, allocator),
+        width_(width) {
+    assert(width > 0 && width <= std::numeric_limits<T>::digits);
+  }
+
+  // Uses the width of the largest element
+  DynamicCompactVector(const T *elements, size_type num_elements, Allocator *allocator = Allocator::Default())
+      : DynamicCompactVector(num_elements, RequiredWidth(elements, num_elements), allocator) {
+    SetRange(0, num_elements, elements);
+  }
+
+  DynamicCompactVector(const DynamicCompactVector &) = delete;
+  DynamicCompactVector &operator=(const DynamicCompactVector &) = delete;
+
+  ~DynamicCompactVector() override = default;
+
+  void Init(const T *elements, size_type num_elements) {
+    Init(elements, num_elements, RequiredWidth(elements, num_elements));
+  }
+
+  void Init(const T *elements, size_type num_elements, width_type width) {
+    assert(width > 0 && width <= std::numeric_limits<T>::digits);
+    Destroy();
+    width_ = width;
+    BitVector::Init(num_elements * width_);
+    SetRange(0, num_elements, elements);
+  }
+
+  width_type GetBitWidth() const {
+    return width_;
+  }
+
+  size_type size() const {
+    return size_ / width_;
+  }
+
+  bool empty() const {
+    return size_ == 0;
+  }
+
+  size_type capacity() const {
+    return GetCapacityInBits() / width_;
+  }
+
+  // Ensures that num_elements elements fit at the current width without
+  // reallocating
+  void Reserve(size_type num_elements) {
+    BitVector::Reserve(num_elements * width_);
+  }
+
+  // Repacks every element to the given (larger) width
+  void Widen(width_type width) {
+    assert(width >= width_ && width <= std::numeric_limits<T>::digits);
+    assert(!IsMapped());
+    if (width == width_)
+      return;
+
+    const size_type kChunkSize = 1024;
+    size_type num_elements = size();
+    size_type num_blocks = BITS2BLOCKS(capacity() * width);
+    auto *data = static_cast<data_type *>(allocator_->Allocate(num_blocks * sizeof(data_type)));
+
+    auto unpack = BitPackKernels<T>::Unpack(width_);
+    auto pack = BitPackKernels<T>::Pack(width);
+    T chunk[kChunkSize];
+    for (pos_type i = 0; i < num_elements; i += kChunkSize) {
+      size_type count = std::min(kChunkSize, num_elements - i);
+      unpack(data_, BITS2BLOCKS(size_), i, count, chunk);
+      pack(data, i, count, chunk);
+    }
+
+    Destroy();
+    data_ = data;
+    capacity_ = num_blocks;
+    size_ = num_elements * width;
+    width_ = width;
+  }
+
+  // Accessors and mutators
+  void Append(T val) {
+    WidenFor(val);
+    this->AppendVal(val, width_);
+  }
+
+  void Set(pos_type i, T value) {
+    WidenFor(value);
+    this->SetValPos(i * width_, value, width_);
+  }
+
+  T Get(pos_type i) const {
+    return (T) this->GetValPos(i * width_, width_);
+  }
+
+  T operator[](const pos_type &i) const {
+    return Get(i);
+  }
+
+  // Reads elements [start, start + count) into out
+  void GetRange(pos_type start, size_type count, T *out) const {
+    assert(start + count <= size());
+    BitPackKernels<T>::Unpack(width_)(data_, BITS2BLOCKS(size_), start, count, out);
+  }
+
+  // Writes elements [start, start + count) from in, widening if necessary
+  void SetRange(pos_type start, size_type count, const T *in) {
+    assert(start + count <= size());
+    width_type width = RequiredWidth(in, count);
+    if (width > width_)
+      Widen(width);
+    BitPackKernels<T>::Pack(width_)(data_, start, count, in);
+  }
+
+  // Serialization and De-serialization
+  size_type Serialize(std::ostream &out) override {
+    size_type width = width_;
+    out.write(reinterpret_cast<const char *>(&width), sizeof(size_type));
+    return sizeof(size_type) + BitVector::Serialize(out);
+  }
+
+  size_type Deserialize(std::istream &in) override {
+    size_type width;
+    in.read(reinterpret_cast<char *>(&width), sizeof(size_type));
+    width_ = (width_type) width;
+    return sizeof(size_type) + BitVector::Deserialize(in);
+  }
+
+  // The width is stored as a full word, so that the bits that follow it
+  // stay 8-byte aligned for mapping.
+  size_type MemoryMap(const std::string &path, size_type offset = 0) override {
+    Destroy();
+
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+      return 0;
+    size_type width;
+    ssize_t read_size = pread(fd, &width, sizeof(size_type), offset);
+    close(fd);
+    if (read_size != sizeof(size_type) || width == 0 || width > std::numeric_limits<T>::digits)
+      return 0;
+
+    size_type in_size = BitVector::MemoryMap(path, offset + sizeof(size_type));
+    if (in_size == 0)
+      return 0;
+    width_ = (width_type) width;
+    return sizeof(size_type) + in_size;
+  }
+
+ private:
+  static width_type RequiredWidth(const T *elements, size_type num_elements) {
+    T max = 0;
+    for (size_type i = 0; i < num_elements; i++) {
+      max = std::max(max, elements[i]);
+    }
+    return Utils::BitWidth(max);
+  }
+
+  void WidenFor(T value) {
+    if (value > low_bits_set[width_])
+      Widen(Utils::BitWidth(value));
+  }
+
+  width_type width_;
+};
+
+}
+
+#endif // BITMAP_DYNAMIC_COMPACT_VECTOR_H_
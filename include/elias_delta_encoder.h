@@ -0,0 +1,43 @@
+#ifndef BITMAP_ELIAS_DELTA_ENCODER_H_
+#define BITMAP_ELIAS_DELTA_ENCODER_H_
+
+#include "bit_stream.h"
+#include "bit_vector.h"
+#include "elias_gamma_encoder.h"
+#include "utils.h"
+
+namespace bits {
+
+// Elias delta codes: the bit width N of a value as an Elias gamma code,
+// followed by the low N - 1 bits of the value. Values must be > 0. Codes
+// grow with 2 log log(val) instead of the 2 log(val) of gamma codes, so
+// they suit large values.
+template<typename T>
+class EliasDeltaEncoder {
+ public:
+  typedef size_t size_type;
+  typedef size_t pos_type;
+  typedef uint8_t width_type;
+
+  static width_type EncodingSize(T val) {
+    width_type nbits = Utils::BitWidth(val);
+    return EliasGammaEncoder<width_type>::EncodingSize(nbits) + nbits - 1;
+  }
+
+  static void Encode(BitWriter &writer, T val) {
+    assert(val > 0);
+    width_type nbits = Utils::BitWidth(val);
+    EliasGammaEncoder<width_type>::Encode(writer, nbits);
+    writer.WriteBits(val - (1ULL << (nbits - 1)), nbits - 1);
+  }
+
+  template<typename Reader>
+  static T Decode(Reader &reader) {
+    width_type nbits = EliasGammaEncoder<width_type>::Decode(reader);
+    return reader.ReadBits(nbits - 1) + (1ULL << (nbits - 1));
+  }
+};
+
+}
+
+#endif // BITMAP_ELIAS_DELTA_ENCODER_H_
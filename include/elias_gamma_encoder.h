@@ -4,6 +4,7 @@
 #include <vector>
 #include <iostream>
 
+#include "bit_stream.h"
 #include "bit_vector.h"
 #include "compact_vector.h"
 #include "utils.h"
@@ -21,13 +22,19 @@ class EliasGammaEncoder {
     return 2 * (Utils::BitWidth(val) - 1) + 1;
   }
 
-  static void Encode(BitVector &out, pos_type *pos, T val) {
-    uint64_t nbits = Utils::BitWidth(val) - 1;
-    (*pos) += nbits;
+  static void Encode(BitWriter &writer, T val) {
+    width_type nbits = Utils::BitWidth(val) - 1;
     assert((1ULL << nbits) <= val);
-    out.SetBit((*pos)++);
-    out.SetValPos(*pos, val - (1ULL << nbits), nbits);
-    (*pos) += nbits;
+    // nbits zeros, followed by a one and the low nbits bits of val
+    writer.WriteBits(0, nbits);
+    writer.WriteBits(((val - (1ULL << nbits)) << 1) | 1ULL, nbits + 1);
+  }
+
+  static void Encode(BitVector &out, pos_type *pos, T val) {
+    BitWriter writer(out, *pos);
+    Encode(writer, val);
+    writer.Flush();
+    *pos = writer.GetPosition();
   }
 
   static BitVector EncodeArray(std::vector<T> &in) {
@@ -37,31 +44,45 @@ class EliasGammaEncoder {
       out_size += EncodingSize(in[i]);
     }
     BitVector out(out_size);
-    pos_type pos = 0;
+    BitWriter writer(out);
     for (size_t i = 0; i < in.size(); i++) {
-      Encode(out, &pos, in[i]);
+      Encode(writer, in[i]);
     }
+    writer.Flush();
     return out;
   }
 
-  static T Decode(BitVector &in, pos_type *pos) {
-    width_type val_width = 0;
-    while (!in.GetBit(*pos)) {
-      val_width++;
-      (*pos)++;
+  // Decodes a code from the next 64 bits of the reader: a trailing zero
+  // count gives the width of the value, whose bits follow in the same word.
+  // Only the codes of values of 2^32 or more do not fit in a word; these
+  // are read with ReadUnary and ReadBits.
+  template<typename Reader>
+  static T Decode(Reader &reader) {
+    typedef typename Reader::bit_field_type bit_field_type;
+    uint64_t window = reader.PeekWord();
+    width_type val_width = (window != 0) ? __builtin_ctzll(window) : 64;
+    if (val_width < 32) {
+      reader.SkipBits(2 * val_width + 1);
+      return bit_field_type::Extract(window, val_width + 1, val_width) + (1ULL << val_width);
     }
-    (*pos)++;
-    T decoded = in.GetValPos(*pos, val_width) + (1ULL << val_width);
-    (*pos) += val_width;
+
+    val_width = reader.ReadUnary();
+    return reader.ReadBits(val_width) + (1ULL << val_width);
+  }
+
+  static T Decode(BitVector &in, pos_type *pos) {
+    BitReader reader(in, *pos);
+    T decoded = Decode(reader);
+    *pos = reader.GetPosition();
     return decoded;
   }
 
   static std::vector<T> DecodeArray(BitVector &in) {
     std::vector<T> out;
-    pos_type pos = 0;
+    BitReader reader(in);
     auto max_pos = in.GetSizeInBits();
-    while (pos != max_pos) {
-      out.push_back(Decode(in, &pos));
+    while (reader.GetPosition() != max_pos) {
+      out.push_back(Decode(reader));
     }
     return out;
   }
@@ -0,0 +1,47 @@
+#ifndef BITMAP_GOLOMB_RICE_ENCODER_H_
+#define BITMAP_GOLOMB_RICE_ENCODER_H_
+
+#include "bit_stream.h"
+#include "bit_vector.h"
+#include "utils.h"
+
+namespace bits {
+
+// Golomb-Rice codes with parameter k: the quotient (val - 1) >> k in unary,
+// followed by the low k bits of val - 1. Values must be > 0. Codes are
+// close to optimal for geometrically distributed values whose mean is
+// about 2^k / ln(2), e.g. the gaps between uniformly random positions.
+template<typename T>
+class GolombRiceEncoder {
+ public:
+  typedef size_t size_type;
+  typedef size_t pos_type;
+  typedef uint8_t width_type;
+
+  // Parameter for values with the given mean
+  static width_type ChooseParameter(T mean) {
+    // log2(mean * ln(2)), rounded down
+    uint64_t scaled = (uint64_t) ((double) mean * 0.6931471805599453);
+    return (scaled == 0) ? 0 : Utils::BitWidth(scaled) - 1;
+  }
+
+  static size_type EncodingSize(T val, width_type k) {
+    return ((val - 1) >> k) + 1 + k;
+  }
+
+  static void Encode(BitWriter &writer, T val, width_type k) {
+    assert(val > 0);
+    writer.WriteUnary((val - 1) >> k);
+    writer.WriteBits((val - 1) & low_bits_set[k], k);
+  }
+
+  template<typename Reader>
+  static T Decode(Reader &reader, width_type k) {
+    T quotient = reader.ReadUnary();
+    return ((quotient << k) | reader.ReadBits(k)) + 1;
+  }
+};
+
+}
+
+#endif // BITMAP_GOLOMB_RICE_ENCODER_H_
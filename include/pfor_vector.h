@@ -0,0 +1,306 @@
+#ifndef BITMAP_PFOR_VECTOR_H_
+#define BITMAP_PFOR_VECTOR_H_
+
+#include <algorithm>
+#include <limits>
+#include <vector>
+
+#include "bit_pack.h"
+#include "bit_vector.h"
+#include "compact_vector.h"
+#include "utils.h"
+
+namespace bits {
+
+// Block-compressed vector using patched frame-of-reference (PFor) coding
+// "Super-Scalar RAM-CPU Cache Compression", Zukowski et. al.
+//
+// Values are split into blocks of block_size. Each block stores its
+// minimum (the base) and packs the differences from the base with its own
+// bit width. The width is chosen to minimize the block size, so a few
+// outliers do not widen the whole block: their low bits are packed with
+// the rest, and their high bits are stored as exceptions (patches) along
+// with their positions within the block. Since every block holds a
+// multiple of 64 values, every block starts on a 64-bit boundary.
+template<typename T, uint32_t block_size = 128>
+class PForVector {
+ public:
+  static_assert(!std::numeric_limits<T>::is_signed, "Signed types cannot be used.");
+  static_assert(block_size % 64 == 0 && block_size <= 256, "Block size must be a multiple of 64, up to 256.");
+
+  typedef size_t size_type;
+  typedef size_t pos_type;
+  typedef uint8_t width_type;
+  typedef uint64_t data_type;
+  typedef T value_type;
+
+  PForVector() : num_elements_(0) {}
+
+  PForVector(const T *elements, size_type num_elements, Allocator *allocator = Allocator::Default())
+      : PForVector() {
+    SetAllocator(allocator);
+    Encode(elements, num_elements);
+  }
+
+  PForVector(const PForVector &) = delete;
+  PForVector &operator=(const PForVector &) = delete;
+
+  virtual ~PForVector() = default;
+
+  // Sets the allocator used for all components; must be called before encoding
+  void SetAllocator(Allocator *allocator) {
+    bases_.SetAllocator(allocator);
+    widths_.SetAllocator(allocator);
+    offsets_.SetAllocator(allocator);
+    exception_offsets_.SetAllocator(allocator);
+    exception_positions_.SetAllocator(allocator);
+    exception_values_.SetAllocator(allocator);
+    packed_.SetAllocator(allocator);
+  }
+
+  size_type size() const {
+    return num_elements_;
+  }
+
+  bool empty() const {
+    return num_elements_ == 0;
+  }
+
+  size_type NumBlocks() const {
+    return (num_elements_ + block_size - 1) / block_size;
+  }
+
+  T Get(pos_type i) const {
+    pos_type block_id = i / block_size;
+    pos_type block_pos = i % block_size;
+    width_type width = widths_.Get(block_id);
+    T val = (width == 0) ? 0 : (T) packed_.GetValPos(offsets_.Get(block_id) + block_pos * width, width);
+
+    // Patch the value if it is an exception
+    pos_type exception_end = exception_offsets_.Get(block_id + 1);
+    for (pos_type e = exception_offsets_.Get(block_id); e < exception_end; e++) {
+      pos_type exception_pos = exception_positions_.Get(e);
+      if (exception_pos >= block_pos) {
+        if (exception_pos == block_pos)
+          val |= exception_values_.Get(e) << width;
+        break;
+      }
+    }
+
+    return bases_.Get(block_id) + val;
+  }
+
+  T operator[](pos_type i) const {
+    return Get(i);
+  }
+
+  // Decodes all values of the block into out
+  size_type DecodeBlock(pos_type block_id, T *out) const {
+    pos_type begin = block_id * block_size;
+    size_type count = std::min<size_type>(block_size, num_elements_ - begin);
+    width_type width = widths_.Get(block_id);
+    T base = bases_.Get(block_id);
+
+    if (width == 0) {
+      std::fill(out, out + count, base);
+    } else {
+      pos_type block_idx = offsets_.Get(block_id) / 64;
+      BitPackKernels<T>::Unpack(width)(packed_.GetData() + block_idx, BITS2BLOCKS(packed_.GetSizeInBits()) - block_idx,
+                                       0, count, out);
+      for (size_type i = 0; i < count; i++) {
+        out[i] += base;
+      }
+    }
+
+    pos_type exception_end = exception_offsets_.Get(block_id + 1);
+    for (pos_type e = exception_offsets_.Get(block_id); e < exception_end; e++) {
+      out[exception_positions_.Get(e)] += exception_values_.Get(e) << width;
+    }
+
+    return count;
+  }
+
+  // Reads elements [start, start + count) into out
+  void GetRange(pos_type start, size_type count, T *out) const {
+    assert(start + count <= num_elements_);
+    T block[block_size];
+    pos_type end = start + count;
+    while (start < end) {
+      pos_type block_id = start / block_size;
+      pos_type block_pos = start % block_size;
+      size_type block_count = std::min<size_type>(block_size - block_pos, end - start);
+      if (block_pos == 0 && block_count == block_size) {
+        DecodeBlock(block_id, out);
+      } else {
+        DecodeBlock(block_id, block);
+        std::copy(block + block_pos, block + block_pos + block_count, out);
+      }
+      start += block_count;
+      out += block_count;
+    }
+  }
+
+  // Serialization and De-serialization
+  virtual size_type Serialize(std::ostream &out) {
+    size_type out_size = 0;
+
+    out.write(reinterpret_cast<const char *>(&num_elements_), sizeof(size_type));
+    out_size += sizeof(size_type);
+
+    out_size += bases_.Serialize(out);
+    out_size += widths_.Serialize(out);
+    out_size += offsets_.Serialize(out);
+    out_size += exception_offsets_.Serialize(out);
+    out_size += exception_positions_.Serialize(out);
+    out_size += exception_values_.Serialize(out);
+    out_size += packed_.Serialize(out);
+
+    return out_size;
+  }
+
+  virtual size_type Deserialize(std::istream &in) {
+    size_type in_size = 0;
+
+    in.read(reinterpret_cast<char *>(&num_elements_), sizeof(size_type));
+    in_size += sizeof(size_type);
+
+    in_size += bases_.Deserialize(in);
+    in_size += widths_.Deserialize(in);
+    in_size += offsets_.Deserialize(in);
+    in_size += exception_offsets_.Deserialize(in);
+    in_size += exception_positions_.Deserialize(in);
+    in_size += exception_values_.Deserialize(in);
+    in_size += packed_.Deserialize(in);
+
+    return in_size;
+  }
+
+  // Memory maps a serialized vector without copying; see BitVector::MemoryMap
+  virtual size_type MemoryMap(const std::string &path, size_type offset = 0) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+      return 0;
+    ssize_t read_size = pread(fd, &num_elements_, sizeof(size_type), offset);
+    close(fd);
+    if (read_size != sizeof(size_type))
+      return 0;
+
+    size_type in_size = sizeof(size_type);
+    BitVector *components[] = {&bases_, &widths_, &offsets_, &exception_offsets_, &exception_positions_,
+                               &exception_values_, &packed_};
+    for (BitVector *component : components) {
+      size_type component_size = component->MemoryMap(path, offset + in_size);
+      if (component_size == 0)
+        return 0;
+      in_size += component_size;
+    }
+
+    return in_size;
+  }
+
+ private:
+  // Size in bits of an exception: its position and its high bits
+  static const size_type kExceptionSize = 8 + std::numeric_limits<T>::digits;
+
+  // Picks the packed width that minimizes the size of the block, given the
+  // number of values that need each width
+  static width_type BestWidth(const size_type *width_counts, size_type count) {
+    const width_type max_width = std::numeric_limits<T>::digits;
+    width_type best_width = max_width;
+    size_type best_size = count * max_width, num_exceptions = 0;
+    for (width_type width = max_width; width-- > 0;) {
+      num_exceptions += width_counts[width + 1];
+      size_type block_size_bits = count * width + num_exceptions * kExceptionSize;
+      if (block_size_bits < best_size) {
+        best_size = block_size_bits;
+        best_width = width;
+      }
+    }
+    return best_width;
+  }
+
+  void Encode(const T *elements, size_type num_elements) {
+    num_elements_ = num_elements;
+    size_type num_blocks = NumBlocks();
+    if (num_blocks == 0)
+      return;
+
+    std::vector<T> bases(num_blocks), exception_values;
+    std::vector<uint8_t> widths(num_blocks), exception_positions;
+    std::vector<uint64_t> offsets(num_blocks), exception_offsets(num_blocks + 1);
+    size_type packed_size = 0;
+
+    // Pick the base and width of every block, and collect the exceptions
+    for (pos_type block_id = 0; block_id < num_blocks; block_id++) {
+      const T *block = elements + block_id * block_size;
+      size_type count = std::min<size_type>(block_size, num_elements - block_id * block_size);
+      T base = *std::min_element(block, block + count);
+
+      size_type width_counts[std::numeric_limits<T>::digits + 1] = {};
+      for (size_type i = 0; i < count; i++) {
+        T delta = block[i] - base;
+        width_counts[delta == 0 ? 0 : Utils::BitWidth(delta)]++;
+      }
+      width_type width = BestWidth(width_counts, count);
+
+      exception_offsets[block_id] = exception_values.size();
+      for (size_type i = 0; i < count; i++) {
+        T delta = block[i] - base;
+        if (width < std::numeric_limits<T>::digits && (delta >> width) != 0) {
+          exception_positions.push_back((uint8_t) i);
+          exception_values.push_back(delta >> width);
+        }
+      }
+
+      bases[block_id] = base;
+      widths[block_id] = width;
+      offsets[block_id] = packed_size;
+      packed_size += count * width;
+    }
+    exception_offsets[num_blocks] = exception_values.size();
+
+    // Pack the low bits of every value
+    packed_.Init(packed_size);
+    T low_bits[block_size];
+    for (pos_type block_id = 0; block_id < num_blocks; block_id++) {
+      const T *block = elements + block_id * block_size;
+      size_type count = std::min<size_type>(block_size, num_elements - block_id * block_size);
+      width_type width = widths[block_id];
+      if (width == 0)
+        continue;
+      for (size_type i = 0; i < count; i++) {
+        low_bits[i] = (T) ((block[i] - bases[block_id]) & low_bits_set[width]);
+      }
+      BitPackKernels<T>::Pack(width)(packed_.GetData() + offsets[block_id] / 64, 0, count, low_bits);
+    }
+
+    bases_.Init(&bases[0], num_blocks);
+    widths_.Init(&widths[0], num_blocks);
+    offsets_.Init(&offsets[0], num_blocks);
+    exception_offsets_.Init(&exception_offsets[0], num_blocks + 1);
+    exception_positions_.Init(exception_positions.data(), exception_positions.size());
+    exception_values_.Init(exception_values.data(), exception_values.size());
+  }
+
+  size_type num_elements_;
+
+  // Block directory
+  CompactVector<T, std::numeric_limits<T>::digits> bases_;
+  CompactVector<uint8_t, 7> widths_;
+  CompactVector<uint64_t, 64> offsets_;
+  CompactVector<uint64_t, 64> exception_offsets_;
+
+  // Exceptions, ordered by block and position within the block
+  CompactVector<uint8_t, 8> exception_positions_;
+  CompactVector<T, std::numeric_limits<T>::digits> exception_values_;
+
+  // Packed low bits of the differences from the block bases
+  BitVector packed_;
+};
+
+template<typename T, uint32_t block_size>
+const typename PForVector<T, block_size>::size_type PForVector<T, block_size>::kExceptionSize;
+
+}
+
+#endif // BITMAP_PFOR_VECTOR_H_
@@ -0,0 +1,185 @@
+#ifndef BITMAP_RADIX_SORT_H_
+#define BITMAP_RADIX_SORT_H_
+
+#include "compact_vector.h"
+
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+namespace bits {
+
+// LSD radix sort of a CompactVector that works on the packed values, with
+// a scratch vector of the same width; the vector therefore needs
+// 2 * W bits per value while sorting, instead of the 64 bits per value of
+// sorting an unpacked copy.
+//
+// Every pass sorts by a digit of up to kMaxDigitBits bits. The vector is
+// split into one contiguous chunk per thread; the threads count the digits
+// of their chunks, the counts give every (digit, thread) pair its own
+// range of the output, and the threads then scatter their chunks into
+// those ranges through per-digit write buffers. Only values written to a
+// block shared with another range are written atomically. Passes in which
+// all values share the same digit are skipped.
+template<typename T, uint8_t W>
+class RadixSort {
+ public:
+  typedef size_t size_type;
+  typedef size_t pos_type;
+
+  static void Sort(CompactVector<T, W> &vec, size_type num_threads = 1) {
+    assert(!vec.IsMapped());
+    vec.DropSearchIndex();
+    size_type n = vec.size();
+    if (n < 2)
+      return;
+    num_threads = std::max<size_type>(1, std::min(num_threads, n / kMinChunkSize));
+
+    const size_type num_passes = (W + kMaxDigitBits - 1) / kMaxDigitBits;
+    const size_type digit_bits = (W + num_passes - 1) / num_passes;
+    const size_type num_buckets = 1ULL << digit_bits;
+
+    CompactVector<T, W> scratch(n, vec.GetAllocator());
+    CompactVector<T, W> *src = &vec, *dst = &scratch;
+    std::vector<size_type> counts(num_threads * num_buckets), offsets(num_threads * num_buckets);
+    for (size_type shift = 0; shift < W; shift += digit_bits) {
+      std::fill(counts.begin(), counts.end(), 0);
+      RunParallel(num_threads, [&](size_type t) {
+        CountDigits(*src, ChunkBegin(n, num_threads, t), ChunkBegin(n, num_threads, t + 1), shift,
+                    num_buckets - 1, &counts[t * num_buckets]);
+      });
+
+      // Ranges are ordered by digit, then by thread, which keeps the sort stable
+      size_type sum = 0;
+      bool trivial = false;
+      for (size_type b = 0; b < num_buckets; b++) {
+        size_type bucket_begin = sum;
+        for (size_type t = 0; t < num_threads; t++) {
+          offsets[t * num_buckets + b] = sum;
+          sum += counts[t * num_buckets + b];
+        }
+        trivial |= (sum - bucket_begin == n);
+      }
+      if (trivial)
+        continue;
+
+      RunParallel(num_threads, [&](size_type t) {
+        Scatter(*src, dst, ChunkBegin(n, num_threads, t), ChunkBegin(n, num_threads, t + 1), shift,
+                num_buckets - 1, &offsets[t * num_buckets], &counts[t * num_buckets], num_threads > 1);
+      });
+      std::swap(src, dst);
+    }
+
+    if (src != &vec)
+      vec.swap(scratch);
+  }
+
+ private:
+  static const size_type kMaxDigitBits = 11;
+  static const size_type kMinChunkSize = 1ULL << 16;
+  static const size_type kBatchSize = 1024;
+  static const size_type kBufferSize = 64;
+
+  // Number of values at either end of a range whose blocks may be shared
+  // with a neighbouring range
+  static const size_type kEdgeSize = 64 / W + 1;
+
+  static pos_type ChunkBegin(size_type n, size_type num_threads, size_type t) {
+    return n / num_threads * t + std::min(t, n % num_threads);
+  }
+
+  // Runs fn(t) for t in [0, num_threads), on the calling thread and
+  // num_threads - 1 others
+  template<typename Fn>
+  static void RunParallel(size_type num_threads, Fn fn) {
+    std::vector<std::thread> threads;
+    for (size_type t = 1; t < num_threads; t++) {
+      threads.push_back(std::thread(fn, t));
+    }
+    fn(0);
+    for (auto &thread : threads) {
+      thread.join();
+    }
+  }
+
+  static void CountDigits(const CompactVector<T, W> &src, pos_type begin, pos_type end, size_type shift,
+                          T mask, size_type *counts) {
+    T batch[kBatchSize];
+    for (pos_type i = begin; i < end; i += kBatchSize) {
+      size_type count = std::min(kBatchSize, end - i);
+      src.GetRange(i, count, batch);
+      for (size_type j = 0; j < count; j++) {
+        counts[(batch[j] >> shift) & mask]++;
+      }
+    }
+  }
+
+  // Moves the values of [begin, end) to their ranges in dst; the range of
+  // digit b starts at offsets[b] and holds counts[b] values. Values are
+  // staged in a small buffer per digit and written kBufferSize at a time,
+  // which keeps the writes to each range sequential.
+  static void Scatter(const CompactVector<T, W> &src, CompactVector<T, W> *dst, pos_type begin, pos_type end,
+                      size_type shift, T mask, size_type *offsets, const size_type *counts, bool shared) {
+    size_type num_buckets = (size_type) mask + 1;
+    std::vector<pos_type> range_begin(offsets, offsets + num_buckets), range_end(num_buckets);
+    for (size_type b = 0; b < num_buckets; b++) {
+      range_end[b] = offsets[b] + counts[b];
+    }
+
+    std::vector<T> buffers(num_buckets * kBufferSize);
+    std::vector<size_type> buffered(num_buckets, 0);
+    T batch[kBatchSize];
+    for (pos_type i = begin; i < end; i += kBatchSize) {
+      size_type count = std::min(kBatchSize, end - i);
+      src.GetRange(i, count, batch);
+      for (size_type j = 0; j < count; j++) {
+        size_type b = (batch[j] >> shift) & mask;
+        buffers[b * kBufferSize + buffered[b]] = batch[j];
+        if (++buffered[b] == kBufferSize) {
+          Write(dst, offsets[b], kBufferSize, &buffers[b * kBufferSize], range_begin[b], range_end[b], shared);
+          offsets[b] += kBufferSize;
+          buffered[b] = 0;
+        }
+      }
+    }
+
+    for (size_type b = 0; b < num_buckets; b++) {
+      Write(dst, offsets[b], buffered[b], &buffers[b * kBufferSize], range_begin[b], range_end[b], shared);
+      offsets[b] += buffered[b];
+    }
+  }
+
+  // Writes count values at pos of the range [range_begin, range_end)
+  static void Write(CompactVector<T, W> *dst, pos_type pos, size_type count, const T *in, pos_type range_begin,
+                    pos_type range_end, bool shared) {
+    if (!shared || (pos >= range_begin + kEdgeSize && pos + count + kEdgeSize <= range_end)) {
+      dst->SetRange(pos, count, in);
+      return;
+    }
+    for (size_type j = 0; j < count; j++, pos++) {
+      if (pos < range_begin + kEdgeSize || pos + kEdgeSize >= range_end)
+        dst->AtomicSet(pos, in[j]);
+      else
+        dst->Set(pos, in[j]);
+    }
+  }
+};
+
+template<typename T, uint8_t W>
+const typename RadixSort<T, W>::size_type RadixSort<T, W>::kMaxDigitBits;
+
+template<typename T, uint8_t W>
+const typename RadixSort<T, W>::size_type RadixSort<T, W>::kMinChunkSize;
+
+template<typename T, uint8_t W>
+const typename RadixSort<T, W>::size_type RadixSort<T, W>::kBatchSize;
+
+template<typename T, uint8_t W>
+const typename RadixSort<T, W>::size_type RadixSort<T, W>::kBufferSize;
+
+template<typename T, uint8_t W>
+const typename RadixSort<T, W>::size_type RadixSort<T, W>::kEdgeSize;
+
+}
+
+#endif // BITMAP_RADIX_SORT_H_
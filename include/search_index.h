@@ -0,0 +1,136 @@
+#ifndef BITMAP_SEARCH_INDEX_H_
+#define BITMAP_SEARCH_INDEX_H_
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+
+#include "allocator.h"
+
+namespace bits {
+
+// Search layer over a sorted vector, holding every stride-th element in
+// Eytzinger (breadth-first) order. The top levels of the implicit tree
+// share a few cache lines, and the search is branchless and prefetches
+// the keys three to four levels ahead, so a lookup costs a few cache
+// misses in the index plus a short branchless search over stride elements
+// of the vector.
+// "Array Layouts for Comparison-Based Searching", Khuong & Morin
+//
+// The tree is padded to a complete tree with maximal keys, so that every
+// search takes the same number of steps, and the leaf position it ends at
+// is the number of keys <= the searched value.
+//
+// The index is a snapshot: it must be rebuilt after the vector changes.
+template<typename T>
+class EytzingerIndex {
+ public:
+  typedef size_t size_type;
+  typedef size_t pos_type;
+
+  static const size_type kDefaultStride = 16;
+
+  EytzingerIndex() : allocator_(64), keys_(nullptr), num_keys_(0), height_(0), stride_(1) {}
+
+  template<typename Vector>
+  explicit EytzingerIndex(const Vector &vec, size_type stride = kDefaultStride) : EytzingerIndex() {
+    Build(vec, stride);
+  }
+
+  EytzingerIndex(const EytzingerIndex &) = delete;
+  EytzingerIndex &operator=(const EytzingerIndex &) = delete;
+
+  ~EytzingerIndex() {
+    Destroy();
+  }
+
+  // Vector must provide size() and Get(i), with non-decreasing values
+  template<typename Vector>
+  void Build(const Vector &vec, size_type stride = kDefaultStride) {
+    Destroy();
+    stride_ = stride;
+    num_keys_ = (vec.size() + stride - 1) / stride;
+    height_ = 0;
+    while ((1ULL << height_) <= num_keys_)
+      height_++;
+    keys_ = static_cast<T *>(allocator_.Allocate(TreeSize() * sizeof(T)));
+    pos_type rank = 0;
+    Fill(vec, 1, &rank);
+  }
+
+  // Position of the last element of vec that is <= val (0 if there is
+  // none), as CompactVector::LowerBound; vec must be the vector the index
+  // was built from.
+  template<typename Vector>
+  pos_type LowerBound(const Vector &vec, T val) const {
+    size_type k = 1;
+    for (size_type level = 0; level < height_; level++) {
+      __builtin_prefetch(keys_ + k * kKeysPerLine);
+      k = 2 * k + (keys_[k] <= val);
+    }
+
+    // Number of sampled keys <= val
+    size_type count = std::min<size_type>(k - (1ULL << height_), num_keys_);
+    if (count == 0)
+      return 0;
+
+    // Search the stride that starts with the last of them
+    pos_type lo = (count - 1) * stride_;
+    size_type len = std::min(stride_, vec.size() - lo);
+    while (len > 1) {
+      size_type half = len / 2;
+      lo = (vec.Get(lo + half) <= val) ? lo + half : lo;
+      len -= half;
+    }
+    return lo;
+  }
+
+  size_type GetStride() const {
+    return stride_;
+  }
+
+ private:
+  static const size_type kKeysPerLine = 64 / sizeof(T);
+
+  // Number of entries, including the unused entry 0
+  size_type TreeSize() const {
+    return 1ULL << height_;
+  }
+
+  // In-order traversal of the implicit tree assigns the sampled keys in
+  // sorted order, followed by the padding
+  template<typename Vector>
+  void Fill(const Vector &vec, size_type k, pos_type *rank) {
+    if (k >= TreeSize())
+      return;
+    Fill(vec, 2 * k, rank);
+    keys_[k] = (*rank < num_keys_) ? vec.Get(*rank * stride_) : std::numeric_limits<T>::max();
+    (*rank)++;
+    Fill(vec, 2 * k + 1, rank);
+  }
+
+  void Destroy() {
+    if (keys_ != nullptr)
+      allocator_.Deallocate(keys_, TreeSize() * sizeof(T));
+    keys_ = nullptr;
+    num_keys_ = 0;
+    height_ = 0;
+  }
+
+  AlignedAllocator allocator_;
+  T *keys_;             // 1-indexed, in Eytzinger order
+  size_type num_keys_;  // Number of sampled keys, excluding the padding
+  size_type height_;
+  size_type stride_;
+};
+
+template<typename T>
+const typename EytzingerIndex<T>::size_type EytzingerIndex<T>::kDefaultStride;
+
+template<typename T>
+const typename EytzingerIndex<T>::size_type EytzingerIndex<T>::kKeysPerLine;
+
+}
+
+#endif // BITMAP_SEARCH_INDEX_H_
@@ -0,0 +1,110 @@
+#ifndef BITMAP_STREAM_VBYTE_ENCODER_H_
+#define BITMAP_STREAM_VBYTE_ENCODER_H_
+
+#include <cstdint>
+#include <limits>
+
+#include "bit_ops.h"
+#include "bit_stream.h"
+#include "bit_vector.h"
+#include "utils.h"
+
+namespace bits {
+
+// Shuffle masks and group lengths for every Stream VByte control byte
+static struct StreamVByteTable {
+ public:
+  StreamVByteTable() {
+    for (uint64_t control = 0; control < 256; control++) {
+      uint8_t in_pos = 0;
+      for (uint64_t lane = 0; lane < 4; lane++) {
+        uint8_t length = ((control >> (2 * lane)) & 3) + 1;
+        for (uint8_t byte = 0; byte < 4; byte++) {
+          shuffle_[control][4 * lane + byte] = (byte < length) ? in_pos + byte : 0x80;
+        }
+        in_pos += length;
+      }
+      length_[control] = in_pos;
+    }
+  }
+
+  const uint8_t *shuffle(const uint8_t control) const {
+    return shuffle_[control];
+  }
+
+  uint8_t length(const uint8_t control) const {
+    return length_[control];
+  }
+
+ private:
+  uint8_t shuffle_[256][16]{};
+  uint8_t length_[256]{};
+} stream_vbyte_table;
+
+// Stream VByte codes for 32-bit values: values are taken in
+// groups of four, and the byte lengths (1 to 4) of the values of a group
+// are packed two bits each into a control byte, stored apart from the data
+// bytes. A whole group is decoded with one byte shuffle of 16 data bytes,
+// whose mask is selected by the control byte.
+template<typename T>
+class StreamVByteEncoder {
+ public:
+  static_assert(std::numeric_limits<T>::digits == 32, "Values must be 32-bit unsigned integers.");
+  typedef size_t size_type;
+  typedef size_t pos_type;
+  typedef uint8_t width_type;
+
+  // Size of the data bytes of the value
+  static width_type EncodingSize(T val) {
+    return (val < (1U << 8)) ? 1 : (val < (1U << 16)) ? 2 : (val < (1U << 24)) ? 3 : 4;
+  }
+
+  // Control byte of a group of up to four values
+  static uint8_t Control(const T *vals, size_type count) {
+    uint8_t control = 0;
+    for (size_type lane = 0; lane < count; lane++) {
+      control |= (EncodingSize(vals[lane]) - 1) << (2 * lane);
+    }
+    return control;
+  }
+
+  static width_type Length(uint8_t control, size_type lane) {
+    return ((control >> (2 * lane)) & 3) + 1;
+  }
+
+  // Writes the data bytes of the value
+  static void Encode(BitWriter &writer, T val) {
+    writer.WriteBits(val, 8 * EncodingSize(val));
+  }
+
+  static T Decode(const uint8_t *&in, width_type length) {
+    T val = 0;
+    for (width_type byte = 0; byte < length; byte++) {
+      val |= (T) in[byte] << (8 * byte);
+    }
+    in += length;
+    return val;
+  }
+
+#ifdef BITS_X86
+  // Decodes a full group, and writes prev plus the running sums of its
+  // values to out; prev is updated to the last of them. Reads 16 bytes
+  // from in, and returns the position of the next group.
+  BITS_TARGET("ssse3")
+  static const uint8_t *DecodePrefixSums(const uint8_t *in, uint8_t control, T *prev, T *out) {
+    __m128i vals = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(in)),
+                                    _mm_loadu_si128(reinterpret_cast<const __m128i *>(
+                                        stream_vbyte_table.shuffle(control))));
+    vals = _mm_add_epi32(vals, _mm_slli_si128(vals, 4));
+    vals = _mm_add_epi32(vals, _mm_slli_si128(vals, 8));
+    vals = _mm_add_epi32(vals, _mm_set1_epi32((int) *prev));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(out), vals);
+    *prev = out[3];
+    return in + stream_vbyte_table.length(control);
+  }
+#endif
+};
+
+}
+
+#endif // BITMAP_STREAM_VBYTE_ENCODER_H_
@@ -1,6 +1,13 @@
 #ifndef BITMAP_UTILS_H_
 #define BITMAP_UTILS_H_
 
+#include <cstdint>
+#ifdef __BMI2__
+#include <immintrin.h>
+#endif
+
+#include "cpu_info.h"
+
 #define GETBIT(n, i)    ((n >> i) & 1UL)
 #define SETBIT(n, i)    n = (n | (1UL << i))
 #define CLRBIT(n, i)  n = (n & ~(1UL << i))
@@ -113,23 +120,63 @@ namespace bits {
 
 class Utils {
  public:
+  // Number of bits needed to represent n (1 for n = 0)
   static uint8_t BitWidth(uint64_t n) {
-    uint8_t l = 1;
-    while (n >>= 1)
-      ++l;
-    return l;
+    return (n == 0) ? 1 : 64 - __builtin_clzll(n);
   }
 
   static uint8_t Popcount64bit(uint64_t n) {
     return __builtin_popcountll(n);
   }
 
-  static uint16_t Popcount512bit(uint64_t *data) {
+  static uint16_t Popcount512bit(const uint64_t *data) {
     return __builtin_popcountll(*data) + __builtin_popcountll(*(data + 1))
         + __builtin_popcountll(*(data + 2)) + __builtin_popcountll(*(data + 3))
         + __builtin_popcountll(*(data + 4)) + __builtin_popcountll(*(data + 5))
         + __builtin_popcountll(*(data + 6)) + __builtin_popcountll(*(data + 7));
   }
+
+  // Position of the k-th (0-indexed) set bit in n; requires k < Popcount64bit(n).
+  // Uses PDEP if the CPU supports BMI2, and broadword select otherwise.
+  static uint8_t Select64bit(uint64_t n, uint8_t k) {
+#ifdef __BMI2__
+    return (uint8_t) __builtin_ctzll(_pdep_u64(1ULL << k, n));
+#else
+#ifdef BITS_X86
+    if (CpuInfo::HasBMI2())
+      return PdepSelect64bit(n, k);
+#endif
+    return BroadwordSelect64bit(n, k);
+#endif
+  }
+
+  // Broadword select: compute byte-wise prefix popcounts, locate the byte
+  // holding the k-th set bit, then finish the search within that byte.
+  static uint8_t BroadwordSelect64bit(uint64_t n, uint8_t k) {
+    const uint64_t kL8 = 0x0101010101010101ULL;
+    const uint64_t kH8 = 0x8080808080808080ULL;
+    uint64_t s = n - ((n >> 1) & 0x5555555555555555ULL);
+    s = (s & 0x3333333333333333ULL) + ((s >> 2) & 0x3333333333333333ULL);
+    s = ((s + (s >> 4)) & 0x0F0F0F0F0F0F0F0FULL) * kL8;
+    uint64_t place = Popcount64bit((((k * kL8) | kH8) - s) & kH8) * 8;
+    uint64_t byte_rank = k - (((s << 8) >> place) & 0xFF);
+    uint64_t byte = (n >> place) & 0xFF;
+    for (; byte_rank != 0; byte_rank--)
+      byte &= byte - 1;
+    return (uint8_t) (place + __builtin_ctzll(byte));
+  }
+
+#ifdef BITS_X86
+  // Select with PDEP and TZCNT; must only be used if CpuInfo::HasBMI2(). The
+  // instructions are emitted with inline assembly, so that this inlines into
+  // code that is not compiled for BMI2.
+  static uint8_t PdepSelect64bit(uint64_t n, uint8_t k) {
+    uint64_t bit, pos;
+    __asm__("pdep %2, %1, %0" : "=r"(bit) : "r"(1ULL << k), "rm"(n));
+    __asm__("tzcnt %1, %0" : "=r"(pos) : "rm"(bit));
+    return (uint8_t) pos;
+  }
+#endif
 };
 
 }
@@ -0,0 +1,45 @@
+#ifndef BITMAP_VBYTE_ENCODER_H_
+#define BITMAP_VBYTE_ENCODER_H_
+
+#include "bit_stream.h"
+#include "bit_vector.h"
+#include "utils.h"
+
+namespace bits {
+
+// Variable-byte codes: 7 bits of the value per byte, least significant
+// group first, with the high bit of every byte but the last set. Codes are
+// byte aligned, so they are decoded with byte loads instead of bit
+// extraction.
+template<typename T>
+class VByteEncoder {
+ public:
+  typedef size_t size_type;
+  typedef size_t pos_type;
+  typedef uint8_t width_type;
+
+  // Size of the code in bytes
+  static width_type EncodingSize(T val) {
+    return (Utils::BitWidth(val) + 6) / 7;
+  }
+
+  static void Encode(BitWriter &writer, T val) {
+    while (val >= 0x80) {
+      writer.WriteBits((val & 0x7F) | 0x80, 8);
+      val >>= 7;
+    }
+    writer.WriteBits(val, 8);
+  }
+
+  static T Decode(const uint8_t *&in) {
+    T val = *in & 0x7F;
+    for (width_type shift = 7; *in++ & 0x80; shift += 7) {
+      val |= (T) (*in & 0x7F) << shift;
+    }
+    return val;
+  }
+};
+
+}
+
+#endif // BITMAP_VBYTE_ENCODER_H_
@@ -0,0 +1,71 @@
+#include "allocator.h"
+#include "compact_vector.h"
+#include "delta_encoded_array.h"
+
+#include "gtest/gtest.h"
+
+class AllocatorTest : public testing::Test {
+ public:
+  const uint64_t kArraySize = (1024ULL * 1024ULL);
+
+ protected:
+  void CheckCompactVector(bits::Allocator *allocator) {
+    bits::CompactVector<uint64_t, 20> v;
+    v.SetAllocator(allocator);
+    for (uint64_t i = 0; i < kArraySize; i++) {
+      v.Append(i);
+    }
+    for (uint64_t i = 0; i < kArraySize; i++) {
+      ASSERT_EQ(v[i], i);
+    }
+
+    v.ShrinkToFit();
+    for (uint64_t i = 0; i < kArraySize; i++) {
+      ASSERT_EQ(v[i], i);
+    }
+
+    bits::CompactVector<uint64_t, 20> w(kArraySize, allocator);
+    for (uint64_t i = 0; i < kArraySize; i++) {
+      ASSERT_EQ(w[i], 0U);
+    }
+  }
+};
+
+TEST_F(AllocatorTest, MallocAllocatorTest) {
+  CheckCompactVector(bits::Allocator::Default());
+}
+
+TEST_F(AllocatorTest, AlignedAllocatorTest) {
+  bits::AlignedAllocator allocator(64);
+  bits::BitVector v(1000, &allocator);
+  ASSERT_EQ(reinterpret_cast<uintptr_t>(v.GetData()) % 64, 0U);
+  CheckCompactVector(&allocator);
+}
+
+TEST_F(AllocatorTest, HugePageAllocatorTest) {
+  bits::HugePageAllocator allocator;
+  bits::BitVector v(1000, &allocator);
+  ASSERT_EQ(reinterpret_cast<uintptr_t>(v.GetData()) % bits::PageAllocator::kHugePageSize, 0U);
+  CheckCompactVector(&allocator);
+}
+
+TEST_F(AllocatorTest, NumaAllocatorTest) {
+  bits::NumaAllocator allocator(0);
+  CheckCompactVector(&allocator);
+}
+
+TEST_F(AllocatorTest, ArenaAllocatorTest) {
+  bits::ArenaAllocator allocator(1024 * 1024);
+  CheckCompactVector(&allocator);
+
+  auto *array = new uint64_t[kArraySize];
+  for (uint64_t i = 0; i < kArraySize; i++) {
+    array[i] = i * 2;
+  }
+
+  bits::EliasGammaDeltaEncodedVector<uint64_t> enc_array(array, kArraySize, &allocator);
+  for (uint64_t i = 0; i < kArraySize; i++) {
+    ASSERT_EQ(enc_array[i], i * 2);
+  }
+  delete[] array;
+}
@@ -0,0 +1,139 @@
+#include "atomic_compact_vector.h"
+
+#include <cstdio>
+#include <fstream>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+class AtomicCompactVectorTest : public testing::Test {
+ public:
+  const uint64_t kArraySize = (1024ULL * 1024ULL);  // 1 KBytes
+  const uint64_t kNumThreads = 8;
+};
+
+TEST_F(AtomicCompactVectorTest, GetSetTest) {
+  // Six 20-bit values per lane; the fourth spans both blocks of its lane
+  bits::AtomicCompactVector<uint64_t, 20> v(kArraySize);
+  for (uint64_t i = 0; i < kArraySize; i++) {
+    v.Set(i, i);
+  }
+
+  for (uint64_t i = 0; i < kArraySize; i++) {
+    ASSERT_EQ(v.Get(i), i);
+    ASSERT_EQ(v.Load(i), i);
+  }
+}
+
+TEST_F(AtomicCompactVectorTest, FetchAddTest) {
+  const uint64_t kNumCounters = 1000;
+  const uint64_t kNumIncrements = 100000;
+  bits::AtomicCompactVector<uint32_t, 20> counters(kNumCounters);
+
+  // Every thread increments every counter, so neighbouring counters,
+  // including ones spanning two blocks, are updated concurrently
+  std::vector<std::thread> threads;
+  for (uint64_t t = 0; t < kNumThreads; t++) {
+    threads.push_back(std::thread([&counters, t, kNumCounters, kNumIncrements]() {
+      for (uint64_t i = 0; i < kNumIncrements; i++) {
+        counters.FetchAdd((i * 7 + t) % kNumCounters, 1);
+      }
+    }));
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+
+  uint64_t total = 0;
+  for (uint64_t i = 0; i < kNumCounters; i++) {
+    ASSERT_EQ(counters.Get(i), kNumThreads * kNumIncrements / kNumCounters);
+    total += counters.Get(i);
+  }
+  ASSERT_EQ(total, kNumThreads * kNumIncrements);
+
+  // Wraps around modulo 2^20
+  ASSERT_EQ(counters.FetchAdd(3, (1U << 20) - 800), 800U);
+  ASSERT_EQ(counters.Get(3), 0U);
+  ASSERT_EQ(counters.Get(2), 800U);
+  ASSERT_EQ(counters.Get(4), 800U);
+}
+
+TEST_F(AtomicCompactVectorTest, CompareExchangeTest) {
+  const uint64_t kNumCounters = 64;
+  const uint64_t kNumIncrements = 6400;
+  bits::AtomicCompactVector<uint64_t, 44> counters(kNumCounters);
+
+  std::vector<std::thread> threads;
+  for (uint64_t t = 0; t < kNumThreads; t++) {
+    threads.push_back(std::thread([&counters, kNumCounters, kNumIncrements]() {
+      for (uint64_t i = 0; i < kNumIncrements; i++) {
+        uint64_t val = counters.Load(i % kNumCounters);
+        while (!counters.CompareExchange(i % kNumCounters, val, val + 3)) {
+        }
+      }
+    }));
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+
+  for (uint64_t i = 0; i < kNumCounters; i++) {
+    ASSERT_EQ(counters.Get(i), 3 * kNumThreads * kNumIncrements / kNumCounters);
+  }
+
+  uint64_t expected = 5;
+  ASSERT_FALSE(counters.CompareExchange(1, expected, 7));
+  ASSERT_EQ(expected, counters.Get(1));
+  ASSERT_TRUE(counters.CompareExchange(1, expected, 7));
+  ASSERT_EQ(counters.Get(1), 7U);
+}
+
+TEST_F(AtomicCompactVectorTest, AtomicSetTest) {
+  bits::AtomicCompactVector<uint64_t, 33> v(kArraySize);
+
+  std::vector<std::thread> threads;
+  for (uint64_t t = 0; t < kNumThreads; t++) {
+    threads.push_back(std::thread([&v, t, this]() {
+      for (uint64_t i = t; i < kArraySize; i += kNumThreads) {
+        v.AtomicSet(i, i << 10);
+      }
+    }));
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+
+  for (uint64_t i = 0; i < kArraySize; i++) {
+    ASSERT_EQ(v.Get(i), i << 10);
+  }
+}
+
+TEST_F(AtomicCompactVectorTest, SerializeTest) {
+  bits::AtomicCompactVector<uint64_t, 20> v(kArraySize);
+  for (uint64_t i = 0; i < kArraySize; i++) {
+    v.FetchAdd(i, i * 3 % 1000);
+  }
+
+  std::string path = "atomic_compact_vector_test.bin";
+  {
+    std::ofstream out(path, std::ios::binary);
+    v.Serialize(out);
+  }
+
+  bits::AtomicCompactVector<uint64_t, 20> deserialized;
+  {
+    std::ifstream in(path, std::ios::binary);
+    deserialized.Deserialize(in);
+  }
+
+  bits::AtomicCompactVector<uint64_t, 20> mapped;
+  ASSERT_NE(mapped.MemoryMap(path), 0U);
+  ASSERT_EQ(deserialized.size(), kArraySize);
+  ASSERT_EQ(mapped.size(), kArraySize);
+  for (uint64_t i = 0; i < kArraySize; i++) {
+    ASSERT_EQ(deserialized.Load(i), i * 3 % 1000);
+    ASSERT_EQ(mapped.Load(i), i * 3 % 1000);
+  }
+  std::remove(path.c_str());
+}
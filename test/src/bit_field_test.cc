@@ -0,0 +1,90 @@
+#include "bit_field.h"
+#include "bit_stream.h"
+#include "elias_gamma_encoder.h"
+
+#include <random>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+// Utils::Select64bit, which picks PDEP or broadword select on the CPU
+struct DispatchedSelect {
+  static uint8_t SelectInWord(uint64_t x, uint8_t k) {
+    return bits::Utils::Select64bit(x, k);
+  }
+};
+
+class BitFieldTest : public testing::Test {
+ public:
+  template<typename BitFieldImpl>
+  void CheckFieldOps() {
+    std::mt19937_64 gen(0);
+    for (uint64_t trial = 0; trial < 1000; trial++) {
+      uint64_t x = gen(), val = gen();
+      for (uint8_t off = 0; off < 64; off++) {
+        for (uint8_t bits = 0; bits + off <= 64; bits++) {
+          uint64_t mask = (bits == 64) ? ~0ULL : ((1ULL << bits) - 1);
+          ASSERT_EQ(BitFieldImpl::LowBits(x, bits), x & mask);
+          ASSERT_EQ(BitFieldImpl::Extract(x, off, bits), (x >> off) & mask);
+          ASSERT_EQ(BitFieldImpl::Insert(x, val & mask, off, bits), (x & ~(mask << off)) | ((val & mask) << off));
+        }
+      }
+    }
+  }
+
+  template<typename BitFieldImpl>
+  void CheckSelect() {
+    std::mt19937_64 gen(0);
+    for (uint64_t trial = 0; trial < 10000; trial++) {
+      uint64_t x = gen() & gen();
+      uint8_t k = 0;
+      for (uint8_t i = 0; i < 64; i++) {
+        if (x & (1ULL << i)) {
+          ASSERT_EQ(BitFieldImpl::SelectInWord(x, k), i);
+          k++;
+        }
+      }
+    }
+  }
+};
+
+TEST_F(BitFieldTest, TableTest) {
+  CheckFieldOps<bits::TableBitField>();
+  CheckSelect<bits::TableBitField>();
+}
+
+#ifdef BITS_X86
+TEST_F(BitFieldTest, BMI2Test) {
+  if (!bits::CpuInfo::HasBMI2())
+    return;
+  CheckFieldOps<bits::BMI2BitField>();
+  CheckSelect<bits::BMI2BitField>();
+}
+#endif
+
+TEST_F(BitFieldTest, DispatchedSelectTest) {
+  CheckSelect<DispatchedSelect>();
+}
+
+TEST_F(BitFieldTest, ReaderTest) {
+  std::vector<uint64_t> values;
+  std::mt19937_64 gen(0);
+  for (uint64_t i = 0; i < 100000; i++) {
+    values.push_back(1 + (gen() >> (gen() % 64)));
+  }
+  bits::BitVector encoded = bits::EliasGammaEncoder<uint64_t>::EncodeArray(values);
+
+  bits::BasicBitReader<bits::TableBitField> table_reader(encoded);
+  for (uint64_t i = 0; i < values.size(); i++) {
+    ASSERT_EQ(bits::EliasGammaEncoder<uint64_t>::Decode(table_reader), values[i]);
+  }
+
+#ifdef BITS_X86
+  if (bits::CpuInfo::HasBMI2()) {
+    bits::BasicBitReader<bits::BMI2BitField> bmi2_reader(encoded);
+    for (uint64_t i = 0; i < values.size(); i++) {
+      ASSERT_EQ(bits::EliasGammaEncoder<uint64_t>::Decode(bmi2_reader), values[i]);
+    }
+  }
+#endif
+}
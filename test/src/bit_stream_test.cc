@@ -0,0 +1,102 @@
+#include "bit_stream.h"
+#include "utils.h"
+
+#include <vector>
+
+#include "gtest/gtest.h"
+
+class BitStreamTest : public testing::Test {
+ public:
+  const uint64_t kBitmapSize = (1024ULL * 1024ULL);  // 1 KBits
+
+ protected:
+  void SetUp() override {
+    bitvec = new bits::BitVector(kBitmapSize);
+  }
+
+  void TearDown() override {
+    delete bitvec;
+  }
+
+  bits::BitVector *bitvec{};
+};
+
+TEST_F(BitStreamTest, ReadWriteBitsTest) {
+  std::vector<uint64_t> vals;
+  std::vector<uint8_t> widths;
+  uint64_t pos = 3, x = 0x9E3779B97F4A7C15ULL;
+  while (true) {
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    uint8_t width = x % 65;
+    if (pos + width > kBitmapSize - 64)
+      break;
+    widths.push_back(width);
+    vals.push_back(x & low_bits_set[width]);
+    pos += width;
+  }
+
+  // Bits around the written range must be preserved
+  bitvec->SetBit(0);
+  bitvec->SetBit(2);
+  bitvec->SetBit(pos);
+  {
+    bits::BitWriter writer(*bitvec, 3);
+    for (size_t i = 0; i < vals.size(); i++) {
+      writer.WriteBits(vals[i], widths[i]);
+    }
+    ASSERT_EQ(writer.GetPosition(), pos);
+  }
+  ASSERT_TRUE(bitvec->GetBit(0));
+  ASSERT_FALSE(bitvec->GetBit(1));
+  ASSERT_TRUE(bitvec->GetBit(2));
+  ASSERT_TRUE(bitvec->GetBit(pos));
+
+  bits::BitReader reader(*bitvec, 3);
+  uint64_t check_pos = 3;
+  for (size_t i = 0; i < vals.size(); i++) {
+    ASSERT_EQ(reader.PeekBits(widths[i]), vals[i]);
+    ASSERT_EQ(reader.ReadBits(widths[i]), vals[i]);
+    ASSERT_EQ(bitvec->GetValPos(check_pos, widths[i]), vals[i]);
+    check_pos += widths[i];
+    ASSERT_EQ(reader.GetPosition(), check_pos);
+  }
+}
+
+TEST_F(BitStreamTest, UnaryTest) {
+  std::vector<uint64_t> vals;
+  {
+    bits::BitWriter writer(*bitvec);
+    for (uint64_t i = 0; i < 1000; i++) {
+      vals.push_back((i * i) % 211);
+      writer.WriteUnary(vals.back());
+    }
+  }
+
+  bits::BitReader reader(*bitvec);
+  for (uint64_t i = 0; i < vals.size(); i++) {
+    ASSERT_EQ(reader.ReadUnary(), vals[i]);
+  }
+}
+
+TEST_F(BitStreamTest, SeekSkipTest) {
+  for (uint64_t i = 0; i < kBitmapSize; i += 3) {
+    bitvec->SetBit(i);
+  }
+
+  bits::BitReader reader(*bitvec);
+  uint64_t pos = 0;
+  for (uint64_t skip = 1; pos + skip + 16 < kBitmapSize; skip = (skip * 7) % 1009 + 1) {
+    reader.SkipBits(skip);
+    pos += skip;
+    ASSERT_EQ(reader.GetPosition(), pos);
+    ASSERT_EQ(reader.PeekBits(16), bitvec->GetValPos(pos, 16));
+    if (pos + 64 <= kBitmapSize) {
+      ASSERT_EQ(reader.PeekWord(), bitvec->GetValPos(pos, 64));
+    }
+  }
+
+  reader.Seek(kBitmapSize - 5);
+  ASSERT_EQ(reader.ReadBits(5), bitvec->GetValPos(kBitmapSize - 5, 5));
+}
@@ -1,6 +1,12 @@
 #include "bit_vector.h"
 #include "utils.h"
 
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <thread>
+#include <vector>
+
 #include "gtest/gtest.h"
 
 class BitVectorTest : public testing::Test {
@@ -62,3 +68,277 @@ TEST_F(BitVectorTest, AppendGetValTest) {
     pos += bits::Utils::BitWidth(i);
   }
 }
+
+TEST_F(BitVectorTest, MemoryMapTest) {
+  for (uint64_t i = 0; i < kBitmapSize; i++) {
+    if (i % 3 == 0) {
+      bitvec->SetBit(i);
+    }
+  }
+
+  const std::string path = "bit_vector_mmap_test.bin";
+  std::ofstream out(path, std::ios::binary);
+  uint64_t out_size = bitvec->Serialize(out);
+  out_size += bitvec->Serialize(out);
+  out.close();
+
+  bits::BitVector first, second;
+  uint64_t in_size = first.MemoryMap(path);
+  in_size += second.MemoryMap(path, in_size);
+  ASSERT_EQ(in_size, out_size);
+  ASSERT_TRUE(first.IsMapped());
+  ASSERT_EQ(first.GetSizeInBits(), kBitmapSize);
+  ASSERT_EQ(second.GetSizeInBits(), kBitmapSize);
+
+  for (uint64_t i = 0; i < kBitmapSize; i++) {
+    ASSERT_EQ(first.GetBit(i), i % 3 == 0);
+    ASSERT_EQ(second.GetBit(i), i % 3 == 0);
+  }
+
+  first.Destroy();
+  ASSERT_FALSE(first.IsMapped());
+  ASSERT_EQ(first.MemoryMap(path, out_size), 0U);
+  std::remove(path.c_str());
+}
+
+TEST_F(BitVectorTest, MemoryMapUnalignedTest) {
+  bitvec->SetBit(7);
+
+  // The data is preceded by a 4-byte header, so it is not 8-byte aligned
+  const std::string path = "bit_vector_mmap_unaligned_test.bin";
+  std::ofstream out(path, std::ios::binary);
+  uint32_t header = 0;
+  out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+  bitvec->Serialize(out);
+  out.close();
+
+  bits::BitVector mapped;
+  ASSERT_EQ(mapped.MemoryMap(path, sizeof(header)), 0U);
+  ASSERT_FALSE(mapped.IsMapped());
+  ASSERT_EQ(mapped.GetData(), nullptr);
+  std::remove(path.c_str());
+}
+
+TEST_F(BitVectorTest, BulkOpsTest) {
+  const uint64_t kSize = kBitmapSize + 13;
+  bits::BitVector a(kSize), b(kSize);
+  for (uint64_t i = 0; i < kSize; i++) {
+    if (i % 2 == 0)
+      a.SetBit(i);
+    if (i % 3 == 0)
+      b.SetBit(i);
+  }
+
+  bits::BitVector and_vec, or_vec, xor_vec, andnot_vec, not_vec;
+  bits::BitVector::And(and_vec, a, b);
+  bits::BitVector::Or(or_vec, a, b);
+  bits::BitVector::Xor(xor_vec, a, b);
+  bits::BitVector::AndNot(andnot_vec, a, b);
+  bits::BitVector::Not(not_vec, a);
+
+  for (uint64_t i = 0; i < kSize; i++) {
+    bool x = (i % 2 == 0), y = (i % 3 == 0);
+    ASSERT_EQ(and_vec.GetBit(i), x && y);
+    ASSERT_EQ(or_vec.GetBit(i), x || y);
+    ASSERT_EQ(xor_vec.GetBit(i), x != y);
+    ASSERT_EQ(andnot_vec.GetBit(i), x && !y);
+    ASSERT_EQ(not_vec.GetBit(i), !x);
+  }
+  ASSERT_EQ(not_vec.GetData()[kSize / 64] >> (kSize % 64), 0U);
+
+  a.Xor(b);
+  a.Not();
+  for (uint64_t i = 0; i < kSize; i++) {
+    ASSERT_EQ(a.GetBit(i), (i % 2 == 0) == (i % 3 == 0));
+  }
+}
+
+TEST_F(BitVectorTest, RangeOpsTest) {
+  bitvec->Clear();
+  bitvec->SetRange(3, 1000);
+  bitvec->ClearRange(100, 130);
+  bitvec->SetRange(110, 115);
+  bitvec->SetRange(5000, 5001);
+
+  for (uint64_t i = 0; i < 6000; i++) {
+    bool expected = (i >= 3 && i < 100) || (i >= 110 && i < 115) || (i >= 130 && i < 1000) || i == 5000;
+    ASSERT_EQ(bitvec->GetBit(i), expected);
+  }
+
+  // Unaligned copy from another vector
+  bits::BitVector dst(10000);
+  dst.Clear();
+  dst.CopyRange(*bitvec, 1, 67, 5500);
+  for (uint64_t i = 0; i < 10000; i++) {
+    bool expected = (i >= 67 && i < 67 + 5500) && bitvec->GetBit(i - 66);
+    ASSERT_EQ(dst.GetBit(i), expected);
+  }
+
+  // Overlapping copies within the same vector, in both directions
+  dst.CopyRange(dst, 67, 200, 5500);
+  for (uint64_t i = 200; i < 5700; i++) {
+    ASSERT_EQ(dst.GetBit(i), bitvec->GetBit(i - 199));
+  }
+  dst.CopyRange(dst, 200, 64, 5500);
+  for (uint64_t i = 64; i < 5564; i++) {
+    ASSERT_EQ(dst.GetBit(i), bitvec->GetBit(i - 63));
+  }
+  dst.CopyRange(dst, 64, 128, 5500);
+  for (uint64_t i = 128; i < 5628; i++) {
+    ASSERT_EQ(dst.GetBit(i), bitvec->GetBit(i - 127));
+  }
+}
+
+TEST_F(BitVectorTest, SetBitEnumerationTest) {
+  const uint64_t kSize = kBitmapSize + 37;
+  bits::BitVector sparse(kSize);
+  std::vector<uint64_t> expected;
+  srand(0);
+  for (uint64_t i = 0; i < kSize; i++) {
+    if (rand() % 500 == 0 || (i >= 4000 && i < 4100) || i == kSize - 1) {
+      sparse.SetBit(i);
+      expected.push_back(i);
+    }
+  }
+
+  std::vector<uint64_t> visited;
+  sparse.ForEachSetBit([&visited](uint64_t pos) { visited.push_back(pos); });
+  ASSERT_EQ(visited, expected);
+
+  visited.clear();
+  for (auto it = sparse.SetBitsBegin(); it != sparse.SetBitsEnd(); ++it) {
+    visited.push_back(*it);
+  }
+  ASSERT_EQ(visited, expected);
+
+  size_t j = 0;
+  for (uint64_t i = 0; i < kSize; i++) {
+    while (j < expected.size() && expected[j] < i)
+      j++;
+    ASSERT_EQ(sparse.NextSetBit(i), expected[j]);
+    uint64_t prev = (j < expected.size() && expected[j] == i) ? i : (j == 0 ? kSize : expected[j - 1]);
+    ASSERT_EQ(sparse.PrevSetBit(i), prev);
+  }
+  ASSERT_EQ(sparse.NextSetBit(kSize), kSize);
+
+  bits::BitVector empty(kSize);
+  ASSERT_EQ(empty.NextSetBit(0), kSize);
+  ASSERT_EQ(empty.PrevSetBit(kSize - 1), kSize);
+  ASSERT_TRUE(empty.SetBitsBegin() == empty.SetBitsEnd());
+}
+
+TEST_F(BitVectorTest, SetBitEnumerationAfterShrinkTest) {
+  // Shrinking keeps the bits past the new end in the last block
+  bits::BitVector v(1000);
+  v.Clear();
+  v.SetBit(5);
+  v.SetBit(990);
+  v.Resize(970);
+
+  std::vector<uint64_t> visited;
+  for (auto it = v.SetBitsBegin(); it != v.SetBitsEnd(); ++it) {
+    visited.push_back(*it);
+  }
+  ASSERT_EQ(visited, std::vector<uint64_t>({5}));
+
+  v.UnsetBit(5);
+  ASSERT_TRUE(v.SetBitsBegin() == v.SetBitsEnd());
+}
+
+TEST_F(BitVectorTest, CountTest) {
+  srand(0);
+  bitvec->Clear();
+  for (uint64_t i = 0; i < kBitmapSize; i++) {
+    if (rand() % 3 == 0) {
+      bitvec->SetBit(i);
+    }
+  }
+
+  std::vector<uint64_t> prefix(kBitmapSize + 1, 0);
+  for (uint64_t i = 0; i < kBitmapSize; i++) {
+    prefix[i + 1] = prefix[i] + bitvec->GetBit(i);
+  }
+
+  ASSERT_EQ(bitvec->Count(), prefix[kBitmapSize]);
+  for (uint64_t i = 0; i < 10000; i++) {
+    uint64_t begin = rand() % kBitmapSize;
+    uint64_t end = begin + rand() % (kBitmapSize - begin + 1);
+    if (i % 4 == 0)
+      end = std::min(begin + rand() % 200, kBitmapSize);
+    ASSERT_EQ(bitvec->Count(begin, end), prefix[end] - prefix[begin]);
+  }
+  ASSERT_EQ(bitvec->Count(5, 5), 0U);
+}
+
+TEST_F(BitVectorTest, CapacityTest) {
+  bits::BitVector v;
+  uint64_t last_capacity = 0, num_reallocs = 0;
+  for (uint64_t i = 0; i < 100000; i++) {
+    v.AppendVal(i, bits::Utils::BitWidth(i));
+    ASSERT_GE(v.GetCapacityInBits(), v.GetSizeInBits());
+    if (v.GetCapacityInBits() != last_capacity) {
+      last_capacity = v.GetCapacityInBits();
+      num_reallocs++;
+    }
+  }
+  ASSERT_LT(num_reallocs, 64U);
+
+  v.ShrinkToFit();
+  ASSERT_EQ(v.GetCapacityInBits(), BITS2BLOCKS(v.GetSizeInBits()) * 64);
+
+  uint64_t pos = 0;
+  for (uint64_t i = 0; i < 100000; i++) {
+    ASSERT_EQ(v.GetValPos(pos, bits::Utils::BitWidth(i)), i);
+    pos += bits::Utils::BitWidth(i);
+  }
+
+  bits::BitVector r;
+  r.Reserve(10000);
+  ASSERT_EQ(r.GetCapacityInBits(), BITS2BLOCKS(10000) * 64);
+  ASSERT_EQ(r.GetSizeInBits(), 0U);
+  for (uint64_t i = 0; i < 10000; i++) {
+    r.AppendVal(1, 1);
+  }
+  ASSERT_EQ(r.GetCapacityInBits(), BITS2BLOCKS(10000) * 64);
+  ASSERT_EQ(r.Count(), 10000U);
+}
+
+TEST_F(BitVectorTest, AtomicSetBitTest) {
+  const uint64_t kNumThreads = 8;
+  bitvec->Clear();
+
+  // Interleave the threads so that every block is shared by all of them
+  std::vector<std::thread> threads;
+  for (uint64_t t = 0; t < kNumThreads; t++) {
+    threads.push_back(std::thread([this, t, kNumThreads]() {
+      for (uint64_t i = t; i < kBitmapSize; i += kNumThreads) {
+        if (i % 3 != 0)
+          bitvec->AtomicSetBit(i);
+      }
+    }));
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+
+  for (uint64_t i = 0; i < kBitmapSize; i++) {
+    ASSERT_EQ(bitvec->GetBit(i), i % 3 != 0);
+  }
+
+  threads.clear();
+  for (uint64_t t = 0; t < kNumThreads; t++) {
+    threads.push_back(std::thread([this, t, kNumThreads]() {
+      for (uint64_t i = t; i < kBitmapSize; i += kNumThreads) {
+        if (i % 2 == 0)
+          bitvec->AtomicUnsetBit(i);
+      }
+    }));
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+
+  for (uint64_t i = 0; i < kBitmapSize; i++) {
+    ASSERT_EQ(bitvec->GetBit(i), i % 3 != 0 && i % 2 != 0);
+  }
+}
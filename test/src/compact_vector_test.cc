@@ -1,5 +1,12 @@
 #include "compact_vector.h"
 
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <numeric>
+#include <thread>
+#include <vector>
+
 #include "gtest/gtest.h"
 
 class CompactVectorTest : public testing::Test {
@@ -30,6 +37,172 @@ TEST_F(CompactVectorTest, CompactVectorTest2) {
   }
 }
 
+TEST_F(CompactVectorTest, CompactVectorIteratorTest) {
+  bits::CompactVector<uint64_t, 20> v(kArraySize);
+  for (uint64_t i = 0; i < kArraySize; i++) {
+    v[i] = i;
+  }
+
+  const bits::CompactVector<uint64_t, 20> &cv = v;
+  uint64_t i = 0;
+  for (uint64_t val : cv) {
+    ASSERT_EQ(val, i);
+    i++;
+  }
+  ASSERT_EQ(i, kArraySize);
+  ASSERT_EQ(cv.end() - cv.begin(), (ptrdiff_t) kArraySize);
+  ASSERT_EQ(std::accumulate(cv.begin(), cv.end(), UINT64_C(0)), kArraySize * (kArraySize - 1) / 2);
+
+  for (uint64_t val = 0; val < kArraySize; val += 997) {
+    auto it = std::lower_bound(cv.begin(), cv.end(), val);
+    ASSERT_EQ(it - cv.begin(), (ptrdiff_t) val);
+    ASSERT_EQ(*it, val);
+  }
+
+  auto it = cv.end();
+  for (uint64_t j = kArraySize; j-- > kArraySize - 100;) {
+    --it;
+    ASSERT_EQ(*it, j);
+  }
+
+  uint64_t count = 0;
+  for (auto vit = v.begin(); vit != v.end(); ++vit) {
+    count++;
+  }
+  ASSERT_EQ(count, kArraySize);
+  ASSERT_TRUE(v.begin() <= v.end());
+  ASSERT_TRUE(v.end() >= v.begin());
+}
+
+TEST_F(CompactVectorTest, CompactVectorSearchIndexTest) {
+  // Sorted, with gaps and runs of duplicates
+  bits::CompactVector<uint64_t, 30> v(kArraySize);
+  for (uint64_t i = 0; i < kArraySize; i++) {
+    v[i] = 10 + (i / 3) * 5;
+  }
+
+  std::vector<uint64_t> queries = {0, 9, 10, 11, 15, 10 + ((kArraySize - 1) / 3) * 5, 1ULL << 29};
+  for (uint64_t q = 0; q < 100000; q++) {
+    queries.push_back((q * 7919) % (10 + (kArraySize / 3) * 5 + 20));
+  }
+
+  std::vector<uint64_t> expected;
+  for (uint64_t val : queries) {
+    expected.push_back(v.LowerBound(val));
+  }
+
+  for (uint64_t stride : {1, 3, 16, 1000}) {
+    v.BuildSearchIndex(stride);
+    ASSERT_TRUE(v.HasSearchIndex());
+    for (uint64_t q = 0; q < queries.size(); q++) {
+      uint64_t pos = v.LowerBound(queries[q]);
+      // Either search may return any of a run of duplicates
+      ASSERT_EQ(v.Get(pos), v.Get(expected[q]));
+    }
+  }
+  v.DropSearchIndex();
+  ASSERT_FALSE(v.HasSearchIndex());
+}
+
+TEST_F(CompactVectorTest, CompactVectorCopyTest) {
+  bits::CompactVector<uint64_t, 20> v(kArraySize);
+  for (uint64_t i = 0; i < kArraySize; i++) {
+    v[i] = i;
+  }
+
+  const std::string path = "compact_vector_copy_test.bin";
+  std::ofstream out(path, std::ios::binary);
+  v.Serialize(out);
+  out.close();
+
+  // Copies of a mapped vector own their elements, and outlive the mapping
+  auto *mapped = new bits::CompactVector<uint64_t, 20>();
+  ASSERT_NE(mapped->MemoryMap(path), 0);
+  ASSERT_TRUE(mapped->IsMapped());
+  mapped->BuildSearchIndex();
+  bits::CompactVector<uint64_t, 20> copy(*mapped);
+  bits::CompactVector<uint64_t, 20> assigned(10);
+  assigned = *mapped;
+  delete mapped;
+  std::remove(path.c_str());
+
+  for (auto *w : {&copy, &assigned}) {
+    ASSERT_FALSE(w->IsMapped());
+    ASSERT_TRUE(w->HasSearchIndex());
+    ASSERT_EQ(w->size(), kArraySize);
+    for (uint64_t i = 0; i < kArraySize; i++) {
+      ASSERT_EQ((*w)[i], i);
+    }
+    ASSERT_EQ(w->LowerBound(12345), 12345);
+    w->Append(7);
+    ASSERT_EQ((*w)[kArraySize], 7);
+  }
+}
+
+TEST_F(CompactVectorTest, CompactVectorMultiGetTest) {
+  bits::CompactVector<uint64_t, 43> v(kArraySize);
+  for (uint64_t i = 0; i < kArraySize; i++) {
+    v[i] = i * 3;
+  }
+
+  std::vector<uint64_t> idx(100000);
+  for (uint64_t i = 0; i < idx.size(); i++) {
+    idx[i] = (i * 7919) % kArraySize;
+  }
+
+  for (bool group_indices : {false, true}) {
+    std::vector<uint64_t> out(idx.size());
+    v.MultiGet(&idx[0], idx.size(), &out[0], group_indices);
+    for (uint64_t i = 0; i < idx.size(); i++) {
+      ASSERT_EQ(out[i], idx[i] * 3);
+    }
+  }
+}
+
+TEST_F(CompactVectorTest, CompactVectorReserveTest) {
+  bits::CompactVector<uint64_t, 20> v;
+  v.Reserve(kArraySize);
+  ASSERT_GE(v.capacity(), kArraySize);
+  auto capacity = v.capacity();
+  for (uint64_t i = 0; i < kArraySize; i++) {
+    v.Append(i);
+  }
+  ASSERT_EQ(v.capacity(), capacity);
+
+  v.Append(0);
+  ASSERT_GT(v.capacity(), capacity);
+  v.ShrinkToFit();
+  ASSERT_LT(v.capacity(), kArraySize + 4);
+
+  for (uint64_t i = 0; i < kArraySize; i++) {
+    ASSERT_EQ(v[i], i);
+  }
+  ASSERT_EQ(v[kArraySize], 0U);
+}
+
+TEST_F(CompactVectorTest, CompactVectorAtomicSetTest) {
+  const uint64_t kNumThreads = 8;
+  bits::CompactVector<uint64_t, 20> v(kArraySize);
+
+  // Neighbouring elements, including ones spanning two blocks, are written
+  // by different threads
+  std::vector<std::thread> threads;
+  for (uint64_t t = 0; t < kNumThreads; t++) {
+    threads.push_back(std::thread([&v, t, kNumThreads, this]() {
+      for (uint64_t i = t; i < kArraySize; i += kNumThreads) {
+        v.AtomicSet(i, i);
+      }
+    }));
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+
+  for (uint64_t i = 0; i < kArraySize; i++) {
+    ASSERT_EQ(v[i], i);
+  }
+}
+
 TEST_F(CompactVectorTest, CompactPtrVectorTest) {
   bits::CompactPtrVector v;
   for (uint64_t i = 0; i < kArraySize; i++) {
@@ -43,4 +216,85 @@ TEST_F(CompactVectorTest, CompactPtrVectorTest) {
     ASSERT_EQ(*ptr, i);
     free(ptr);
   }
-}
\ No newline at end of file
+}
+template<typename T, uint8_t W>
+static void CheckRangeOps(uint64_t num_elements) {
+  std::vector<T> values(num_elements);
+  uint64_t x = 0x9E3779B97F4A7C15ULL;
+  for (uint64_t i = 0; i < num_elements; i++) {
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    values[i] = (T) (x & low_bits_set[W]);
+  }
+
+  bits::CompactVector<T, W> v(&values[0], num_elements);
+  for (uint64_t i = 0; i < num_elements; i++) {
+    ASSERT_EQ(v.Get(i), values[i]);
+  }
+
+  // Unaligned ranges, including ones shorter than a group of 64 values
+  const uint64_t ranges[][2] = {{0, num_elements}, {3, 1000}, {61, 5}, {64, 640}, {100, num_elements - 100}};
+  for (auto &range : ranges) {
+    std::vector<T> out(range[1]);
+    v.GetRange(range[0], range[1], &out[0]);
+    for (uint64_t i = 0; i < range[1]; i++) {
+      ASSERT_EQ(out[i], values[range[0] + i]);
+    }
+  }
+
+  // Overwrite a range and check that its neighbours are preserved
+  std::vector<T> update(777);
+  for (uint64_t i = 0; i < update.size(); i++) {
+    update[i] = (T) ((values[i] * 31 + 7) & low_bits_set[W]);
+  }
+  v.SetRange(37, update.size(), &update[0]);
+  for (uint64_t i = 0; i < num_elements; i++) {
+    T expected = (i >= 37 && i < 37 + update.size()) ? update[i - 37] : values[i];
+    ASSERT_EQ(v.Get(i), expected);
+  }
+}
+
+TEST_F(CompactVectorTest, CompactVectorRangeTest) {
+  CheckRangeOps<uint64_t, 20>(10007);
+  CheckRangeOps<uint64_t, 33>(10007);
+  CheckRangeOps<uint64_t, 56>(10007);
+  CheckRangeOps<uint64_t, 64>(10007);
+  CheckRangeOps<uint32_t, 7>(10007);
+  CheckRangeOps<uint32_t, 32>(10007);
+  CheckRangeOps<uint16_t, 13>(10007);
+}
+
+template<typename T, uint8_t W>
+static void CheckByteAligned(uint64_t n) {
+  std::vector<T> values(n);
+  bits::CompactVector<T, W> v;
+  for (uint64_t i = 0; i < n; i++) {
+    values[i] = (T) ((i * 0x9E3779B97F4A7C15ULL) & low_bits_set[W]);
+    v.Append(values[i]);
+  }
+  values[3] = (T) low_bits_set[W];
+  v.Set(3, values[3]);
+  values[4] = 1;
+  v.AtomicSet(4, values[4]);
+
+  // The values must match the packed layout, as read by the iterator
+  uint64_t i = 0;
+  for (auto it = v.cbegin(); it != v.cend(); ++it, ++i) {
+    ASSERT_EQ(*it, values[i]);
+    ASSERT_EQ(v.Get(i), values[i]);
+  }
+  ASSERT_EQ(i, n);
+}
+
+TEST_F(CompactVectorTest, CompactVectorByteAlignedTest) {
+  CheckByteAligned<uint64_t, 8>(10007);
+  CheckByteAligned<uint64_t, 16>(10007);
+  CheckByteAligned<uint64_t, 32>(10007);
+  CheckByteAligned<uint64_t, 64>(10007);
+  CheckByteAligned<uint8_t, 8>(10007);
+  CheckByteAligned<uint32_t, 16>(10007);
+  CheckRangeOps<uint64_t, 8>(10007);
+  CheckRangeOps<uint64_t, 16>(10007);
+  CheckRangeOps<uint16_t, 16>(10007);
+}
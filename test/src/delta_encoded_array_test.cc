@@ -1,10 +1,88 @@
 #include "delta_encoded_array.h"
 
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <random>
+#include <vector>
+
 #include "gtest/gtest.h"
 
+// Counts the live allocations made through it
+class CountingAllocator : public bits::MallocAllocator {
+ public:
+  void *Allocate(size_t num_bytes) override {
+    num_allocations_++;
+    return MallocAllocator::Allocate(num_bytes);
+  }
+
+  void Deallocate(void *ptr, size_t num_bytes) override {
+    num_allocations_--;
+    MallocAllocator::Deallocate(ptr, num_bytes);
+  }
+
+  uint64_t num_allocations_ = 0;
+};
+
 class DeltaEncodedVectorTest : public testing::Test {
  public:
   const uint64_t kArraySize = (1024ULL * 1024ULL);  // 1 KBytes
+
+  // Sorted values whose gaps have up to max_gap_bits bits
+  template<typename T>
+  std::vector<T> RandomValues(uint64_t n, uint64_t max_gap_bits, uint64_t seed) {
+    std::mt19937_64 gen(seed);
+    std::vector<T> values(n);
+    values[0] = (T) (gen() % 1024);
+    for (uint64_t i = 1; i < n; i++) {
+      values[i] = values[i - 1] + 1 + (T) (gen() % (1ULL << (gen() % max_gap_bits)));
+    }
+    return values;
+  }
+
+  template<typename Vector, typename T>
+  void CheckCodec(std::vector<T> &values) {
+    Vector enc_array(&values[0], values.size());
+    ASSERT_EQ(enc_array.size(), values.size());
+    for (uint64_t i = 0; i < values.size(); i++) {
+      ASSERT_EQ(enc_array[i], values[i]);
+    }
+
+    for (uint64_t i = 0; i < values.size(); i += 3) {
+      uint64_t idx;
+      ASSERT_TRUE(enc_array.Find(values[i], &idx));
+      ASSERT_EQ(idx, i);
+      if (i + 1 < values.size() && values[i] + 1 != values[i + 1]) {
+        ASSERT_FALSE(enc_array.Find(values[i] + 1, &idx));
+        ASSERT_EQ(idx, i);
+      }
+    }
+
+    const uint64_t kStarts[] = {0, 1, 4, 15, 16, 17, 127, 128, 1000, values.size() - 300, values.size() - 1};
+    std::vector<T> out(values.size());
+    for (uint64_t start : kStarts) {
+      enc_array.DecodeRange(start, values.size() - start, &out[0]);
+      for (uint64_t i = start; i < values.size(); i++) {
+        ASSERT_EQ(out[i - start], values[i]);
+      }
+    }
+
+    const std::string path = "delta_encoded_vector_codec_test.bin";
+    std::ofstream out_file(path, std::ios::binary);
+    uint64_t out_size = enc_array.Serialize(out_file);
+    out_file.close();
+
+    Vector deserialized, mapped;
+    std::ifstream in_file(path, std::ios::binary);
+    ASSERT_EQ(deserialized.Deserialize(in_file), out_size);
+    in_file.close();
+    ASSERT_EQ(mapped.MemoryMap(path), out_size);
+    for (uint64_t i = 0; i < values.size(); i++) {
+      ASSERT_EQ(deserialized[i], values[i]);
+      ASSERT_EQ(mapped[i], values[i]);
+    }
+    std::remove(path.c_str());
+  }
 };
 
 TEST_F(DeltaEncodedVectorTest, EliasGammaEncodedVectorTest) {
@@ -27,3 +105,248 @@ TEST_F(DeltaEncodedVectorTest, EliasGammaEncodedVectorTest) {
     ASSERT_FALSE(enc_array.Find(i * 2 + 1));
   }
 }
+
+TEST_F(DeltaEncodedVectorTest, EliasGammaEncodedVectorSamplingTest) {
+  // Random gaps, and a size that is not a multiple of the sampling rate
+  const uint64_t kSize = kArraySize + 77;
+  std::mt19937_64 gen(0);
+  std::vector<uint64_t> array(kSize);
+  array[0] = gen() % 1024;
+  for (uint64_t i = 1; i < kSize; i++) {
+    array[i] = array[i - 1] + 1 + (gen() % (1ULL << (gen() % 20)));
+  }
+
+  bits::EliasGammaDeltaEncodedVector<uint64_t> enc_array(&array[0], kSize);
+  bits::EliasGammaDeltaEncodedVector<uint64_t, 64, 8> enc_array_64_8(&array[0], kSize);
+  bits::EliasGammaDeltaEncodedVector<uint64_t, 32, 32> enc_array_32_32(&array[0], kSize);
+
+  for (uint64_t i = 0; i < kSize; i++) {
+    ASSERT_EQ(enc_array[i], array[i]);
+    ASSERT_EQ(enc_array_64_8[i], array[i]);
+    ASSERT_EQ(enc_array_32_32[i], array[i]);
+  }
+
+  for (uint64_t i = 0; i < kSize; i += 7) {
+    uint64_t idx;
+    ASSERT_TRUE(enc_array.Find(array[i], &idx));
+    ASSERT_EQ(idx, i);
+    ASSERT_TRUE(enc_array_64_8.Find(array[i], &idx));
+    ASSERT_EQ(idx, i);
+    if (i + 1 < kSize && array[i] + 1 != array[i + 1]) {
+      ASSERT_FALSE(enc_array.Find(array[i] + 1, &idx));
+      ASSERT_EQ(idx, i);
+      ASSERT_FALSE(enc_array_32_32.Find(array[i] + 1, &idx));
+      ASSERT_EQ(idx, i);
+    }
+  }
+}
+
+TEST_F(DeltaEncodedVectorTest, EliasGammaEncodedVectorScanTest) {
+  const uint64_t kSize = kArraySize + 77;
+  std::mt19937_64 gen(1);
+  std::vector<uint64_t> array(kSize);
+  array[0] = 5;
+  for (uint64_t i = 1; i < kSize; i++) {
+    array[i] = array[i - 1] + 1 + (gen() % (1ULL << (gen() % 20)));
+  }
+
+  bits::EliasGammaDeltaEncodedVector<uint64_t> enc_array(&array[0], kSize);
+  ASSERT_EQ(enc_array.size(), kSize);
+
+  uint64_t i = 0;
+  for (auto it = enc_array.begin(); it != enc_array.end(); ++it, ++i) {
+    ASSERT_EQ(*it, array[i]);
+  }
+  ASSERT_EQ(i, kSize);
+
+  // Iterators and ranges starting at, between and just before samples
+  const uint64_t kStarts[] = {0, 1, 15, 16, 17, 127, 128, 129, 1000, kSize - 300, kSize - 1};
+  for (uint64_t start : kStarts) {
+    i = start;
+    for (auto it = bits::EliasGammaDeltaEncodedVector<uint64_t>::const_iterator(&enc_array, start);
+         it != enc_array.end(); it++, i++) {
+      ASSERT_EQ(*it, array[i]);
+    }
+
+    std::vector<uint64_t> out(kSize - start);
+    enc_array.DecodeRange(start, kSize - start, &out[0]);
+    for (i = start; i < kSize; i++) {
+      ASSERT_EQ(out[i - start], array[i]);
+    }
+
+    uint64_t count = std::min<uint64_t>(300, kSize - start);
+    enc_array.DecodeRange(start, count, &out[0]);
+    for (i = 0; i < count; i++) {
+      ASSERT_EQ(out[i], array[start + i]);
+    }
+  }
+
+  bits::EliasGammaDeltaEncodedVector<uint64_t> empty_array(&array[0], 0);
+  ASSERT_TRUE(empty_array.begin() == empty_array.end());
+}
+
+TEST_F(DeltaEncodedVectorTest, EliasGammaEncodedVectorMemoryMapTest) {
+  auto *array = new uint64_t[kArraySize];
+  for (uint64_t i = 0; i < kArraySize; i++) {
+    array[i] = i * 3;
+  }
+
+  const std::string path = "delta_encoded_vector_mmap_test.bin";
+  bits::EliasGammaDeltaEncodedVector<uint64_t> enc_array(array, kArraySize);
+  std::ofstream out(path, std::ios::binary);
+  uint64_t out_size = enc_array.Serialize(out);
+  out.close();
+
+  bits::EliasGammaDeltaEncodedVector<uint64_t> mapped_array;
+  ASSERT_EQ(mapped_array.MemoryMap(path), out_size);
+  ASSERT_EQ(mapped_array.size(), kArraySize);
+
+  for (uint64_t i = 0; i < kArraySize; i++) {
+    ASSERT_EQ(mapped_array[i], i * 3);
+  }
+
+  std::remove(path.c_str());
+  delete[] array;
+}
+
+TEST_F(DeltaEncodedVectorTest, SearchIndexThresholdTest) {
+  typedef bits::EliasGammaDeltaEncodedVector<uint64_t> Vector;
+
+  // A short posting list (one sample) or one just short of 512 bytes of
+  // samples is searched without an index
+  auto small = RandomValues<uint64_t>(48, 10, 7);
+  Vector small_array(&small[0], small.size());
+  ASSERT_FALSE(small_array.HasSearchIndex());
+  auto below = RandomValues<uint64_t>(63 * 128, 10, 8);
+  Vector below_array(&below[0], below.size());
+  ASSERT_FALSE(below_array.HasSearchIndex());
+  uint64_t idx;
+  ASSERT_TRUE(below_array.Find(below[5000], &idx));
+  ASSERT_EQ(idx, 5000);
+
+  auto large = RandomValues<uint64_t>(64 * 128, 10, 9);
+  Vector large_array(&large[0], large.size());
+  ASSERT_TRUE(large_array.HasSearchIndex());
+
+  const std::string path = "delta_encoded_vector_index_test.bin";
+  std::ofstream out(path, std::ios::binary);
+  small_array.Serialize(out);
+  uint64_t small_size = out.tellp();
+  large_array.Serialize(out);
+  out.close();
+
+  Vector small_deserialized, large_deserialized, small_mapped, large_mapped;
+  std::ifstream in(path, std::ios::binary);
+  small_deserialized.Deserialize(in);
+  large_deserialized.Deserialize(in);
+  in.close();
+  ASSERT_FALSE(small_deserialized.HasSearchIndex());
+  ASSERT_TRUE(large_deserialized.HasSearchIndex());
+
+  ASSERT_EQ(small_mapped.MemoryMap(path), small_size);
+  ASSERT_NE(large_mapped.MemoryMap(path, small_size), 0);
+  ASSERT_FALSE(small_mapped.HasSearchIndex());
+  ASSERT_TRUE(large_mapped.HasSearchIndex());
+  for (uint64_t i = 0; i < large.size(); i += 97) {
+    ASSERT_TRUE(large_mapped.Find(large[i], &idx));
+    ASSERT_EQ(idx, i);
+  }
+
+  std::remove(path.c_str());
+}
+
+TEST_F(DeltaEncodedVectorTest, MemoryMapFailureTest) {
+  typedef bits::StreamVByteDeltaEncodedVector<uint32_t> Vector;
+  auto values = RandomValues<uint32_t>(128 * 128, 10, 10);
+  Vector enc_array(&values[0], values.size());
+
+  const std::string path = "delta_encoded_vector_mmap_failure_test.bin";
+  std::ofstream out(path, std::ios::binary);
+  uint64_t out_size = enc_array.Serialize(out);
+  out.close();
+
+  // Truncated inside the storage and inside its last block
+  const std::string truncated_path = "delta_encoded_vector_mmap_truncated_test.bin";
+  std::vector<char> bytes(out_size);
+  std::ifstream in(path, std::ios::binary);
+  in.read(&bytes[0], out_size);
+  in.close();
+  for (uint64_t truncated_size : {out_size / 2, out_size - 8}) {
+    std::ofstream truncated(truncated_path, std::ios::binary | std::ios::trunc);
+    truncated.write(&bytes[0], truncated_size);
+    truncated.close();
+
+    Vector mapped;
+    ASSERT_EQ(mapped.MemoryMap(path), out_size);
+    ASSERT_TRUE(mapped.HasSearchIndex());
+    ASSERT_EQ(mapped.MemoryMap(truncated_path), 0);
+    ASSERT_EQ(mapped.size(), 0);
+    ASSERT_TRUE(mapped.empty());
+    ASSERT_FALSE(mapped.HasSearchIndex());
+  }
+
+  std::remove(truncated_path.c_str());
+  std::remove(path.c_str());
+}
+
+TEST_F(DeltaEncodedVectorTest, SingleAllocationTest) {
+  CountingAllocator allocator;
+  auto values = RandomValues<uint32_t>(48, 10, 11);
+  {
+    bits::EliasGammaDeltaEncodedVector<uint32_t> gamma(&values[0], values.size(), &allocator);
+    bits::GolombRiceDeltaEncodedVector<uint32_t> golomb(&values[0], values.size(), &allocator);
+    bits::StreamVByteDeltaEncodedVector<uint32_t> stream_vbyte(&values[0], values.size(), &allocator);
+    ASSERT_EQ(allocator.num_allocations_, 3);
+    for (uint64_t i = 0; i < values.size(); i++) {
+      ASSERT_EQ(gamma[i], values[i]);
+      ASSERT_EQ(golomb[i], values[i]);
+      ASSERT_EQ(stream_vbyte[i], values[i]);
+    }
+  }
+  ASSERT_EQ(allocator.num_allocations_, 0);
+}
+
+TEST_F(DeltaEncodedVectorTest, EliasDeltaEncodedVectorTest) {
+  auto values = RandomValues<uint64_t>(kArraySize + 77, 40, 2);
+  CheckCodec<bits::EliasDeltaDeltaEncodedVector<uint64_t>>(values);
+  CheckCodec<bits::EliasDeltaDeltaEncodedVector<uint64_t, 64, 64>>(values);
+}
+
+TEST_F(DeltaEncodedVectorTest, GolombRiceEncodedVectorTest) {
+  auto values = RandomValues<uint64_t>(kArraySize + 77, 12, 3);
+  CheckCodec<bits::GolombRiceDeltaEncodedVector<uint64_t>>(values);
+
+  // Mean gap of about 2^10 / 2
+  bits::GolombRiceDeltaEncodedVector<uint64_t> enc_array(&values[0], values.size());
+  ASSERT_GE(enc_array.GetParameter(), 5);
+  ASSERT_LE(enc_array.GetParameter(), 8);
+
+  // Gaps far above the mean
+  auto outliers = RandomValues<uint64_t>(kArraySize, 3, 4);
+  for (uint64_t i = kArraySize / 2; i < kArraySize; i++) {
+    outliers[i] += 1ULL << 16;
+  }
+  CheckCodec<bits::GolombRiceDeltaEncodedVector<uint64_t>>(outliers);
+}
+
+TEST_F(DeltaEncodedVectorTest, VByteEncodedVectorTest) {
+  auto values = RandomValues<uint64_t>(kArraySize + 77, 50, 5);
+  CheckCodec<bits::VByteDeltaEncodedVector<uint64_t>>(values);
+  CheckCodec<bits::VByteDeltaEncodedVector<uint64_t, 32, 8>>(values);
+}
+
+TEST_F(DeltaEncodedVectorTest, StreamVByteEncodedVectorTest) {
+  auto values = RandomValues<uint32_t>(kArraySize + 77, 12, 6);
+  CheckCodec<bits::StreamVByteDeltaEncodedVector<uint32_t>>(values);
+  CheckCodec<bits::StreamVByteDeltaEncodedVector<uint32_t, 64, 8>>(values);
+  CheckCodec<bits::StreamVByteDeltaEncodedVector<uint32_t, 30, 30>>(values);
+
+  // Groups that mix gaps of 1 to 4 bytes
+  std::vector<uint32_t> wide(2000);
+  wide[0] = 0;
+  for (uint64_t i = 1; i < wide.size(); i++) {
+    uint64_t gap_bytes = (i % 16 < 13) ? 1 : i % 16 - 11;
+    wide[i] = wide[i - 1] + (uint32_t) (1ULL << (8 * (gap_bytes - 1))) + (uint32_t) (i % 200);
+  }
+  CheckCodec<bits::StreamVByteDeltaEncodedVector<uint32_t>>(wide);
+}
@@ -0,0 +1,78 @@
+#include "dictionary.h"
+
+#include "gtest/gtest.h"
+
+class DictionaryTest : public testing::Test {
+ public:
+  const uint64_t kBitmapSize = (1024ULL * 1024ULL) + 77;  // ~1 MBits, not block aligned
+
+ protected:
+  void SetUp() override {
+    bitvec = new bits::BitVector(kBitmapSize);
+    srand(0);
+    for (uint64_t i = 0; i < kBitmapSize; i++) {
+      if (rand() % 3 == 0) {
+        bitvec->SetBit(i);
+      }
+    }
+  }
+
+  void TearDown() override {
+    delete bitvec;
+  }
+
+  bits::BitVector *bitvec{};
+};
+
+TEST_F(DictionaryTest, RankTest) {
+  bits::Dictionary dict(*bitvec);
+  ASSERT_EQ(dict.GetSizeInBits(), kBitmapSize);
+
+  uint64_t count = 0;
+  for (uint64_t i = 0; i < kBitmapSize; i++) {
+    ASSERT_EQ(dict.rank1(i), count);
+    ASSERT_EQ(dict.rank0(i), i - count);
+    ASSERT_EQ(dict.GetBit(i), bitvec->GetBit(i));
+    count += bitvec->GetBit(i);
+  }
+  ASSERT_EQ(dict.rank1(kBitmapSize), count);
+}
+
+TEST_F(DictionaryTest, RankAllSetTest) {
+  bits::BitVector ones(kBitmapSize);
+  for (uint64_t i = 0; i < kBitmapSize; i++) {
+    ones.SetBit(i);
+  }
+
+  bits::Dictionary dict(ones);
+  for (uint64_t i = 0; i <= kBitmapSize; i++) {
+    ASSERT_EQ(dict.rank1(i), i);
+    ASSERT_EQ(dict.rank0(i), 0U);
+  }
+}
+
+TEST_F(DictionaryTest, SelectTest) {
+  bits::Dictionary dict(*bitvec);
+
+  uint64_t ones = 0, zeros = 0;
+  for (uint64_t i = 0; i < kBitmapSize; i++) {
+    if (bitvec->GetBit(i)) {
+      ASSERT_EQ(dict.select1(ones++), i);
+    } else {
+      ASSERT_EQ(dict.select0(zeros++), i);
+    }
+  }
+}
+
+TEST_F(DictionaryTest, SelectSparseTest) {
+  bits::BitVector sparse(kBitmapSize);
+  for (uint64_t i = 0; i < kBitmapSize; i += 100003) {
+    sparse.SetBit(i);
+  }
+
+  bits::Dictionary dict(sparse);
+  for (uint64_t i = 0, k = 0; i < kBitmapSize; i += 100003, k++) {
+    ASSERT_EQ(dict.select1(k), i);
+    ASSERT_EQ(dict.rank1(dict.select1(k)), k);
+  }
+}
@@ -0,0 +1,84 @@
+#include "dynamic_compact_vector.h"
+
+#include <cstdio>
+#include <fstream>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+class DynamicCompactVectorTest : public testing::Test {
+ public:
+  const uint64_t kArraySize = (1024ULL * 1024ULL);  // 1 KBytes
+};
+
+TEST_F(DynamicCompactVectorTest, InferWidthTest) {
+  std::vector<uint64_t> values(kArraySize);
+  for (uint64_t i = 0; i < kArraySize; i++) {
+    values[i] = (i * 7919) % 100000;
+  }
+
+  bits::DynamicCompactVector<uint64_t> v(&values[0], kArraySize);
+  ASSERT_EQ(v.GetBitWidth(), 17);
+  ASSERT_EQ(v.size(), kArraySize);
+  for (uint64_t i = 0; i < kArraySize; i++) {
+    ASSERT_EQ(v.Get(i), values[i]);
+  }
+
+  std::vector<uint64_t> out(kArraySize - 5);
+  v.GetRange(5, out.size(), &out[0]);
+  for (uint64_t i = 0; i < out.size(); i++) {
+    ASSERT_EQ(out[i], values[i + 5]);
+  }
+}
+
+TEST_F(DynamicCompactVectorTest, WidenOnAppendTest) {
+  bits::DynamicCompactVector<uint64_t> v;
+  std::vector<uint64_t> values;
+  for (uint64_t i = 0; i < kArraySize; i++) {
+    // Widths grow from 1 to 40 bits over the course of the appends
+    uint64_t val = (i * 0x9E3779B97F4A7C15ULL) & low_bits_set[1 + (i * 40) / kArraySize];
+    values.push_back(val);
+    v.Append(val);
+  }
+
+  ASSERT_EQ(v.GetBitWidth(), 40);
+  ASSERT_EQ(v.size(), kArraySize);
+  for (uint64_t i = 0; i < kArraySize; i++) {
+    ASSERT_EQ(v.Get(i), values[i]);
+  }
+
+  v.Set(3, 1ULL << 50);
+  ASSERT_EQ(v.GetBitWidth(), 51);
+  ASSERT_EQ(v.Get(3), 1ULL << 50);
+  ASSERT_EQ(v.Get(4), values[4]);
+  ASSERT_EQ(v.Get(kArraySize - 1), values[kArraySize - 1]);
+}
+
+TEST_F(DynamicCompactVectorTest, SerializeTest) {
+  bits::DynamicCompactVector<uint32_t> v(kArraySize, 23);
+  for (uint64_t i = 0; i < kArraySize; i++) {
+    v.Set(i, (uint32_t) (i * 3));
+  }
+
+  std::string path = "dynamic_compact_vector_test.bin";
+  {
+    std::ofstream out(path, std::ios::binary);
+    v.Serialize(out);
+  }
+
+  bits::DynamicCompactVector<uint32_t> deserialized;
+  {
+    std::ifstream in(path, std::ios::binary);
+    deserialized.Deserialize(in);
+  }
+
+  bits::DynamicCompactVector<uint32_t> mapped;
+  ASSERT_NE(mapped.MemoryMap(path), 0U);
+  ASSERT_EQ(deserialized.GetBitWidth(), 23);
+  ASSERT_EQ(mapped.GetBitWidth(), 23);
+  for (uint64_t i = 0; i < kArraySize; i++) {
+    ASSERT_EQ(deserialized.Get(i), i * 3);
+    ASSERT_EQ(mapped.Get(i), i * 3);
+  }
+  std::remove(path.c_str());
+}
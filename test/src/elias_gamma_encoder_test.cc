@@ -1,5 +1,7 @@
 #include "elias_gamma_encoder.h"
 
+#include <random>
+
 #include "gtest/gtest.h"
 
 class EliasGammaEncoderTest : public testing::Test {
@@ -21,3 +23,42 @@ TEST_F(EliasGammaEncoderTest, EliasGammaEncodedArrayTest) {
     ASSERT_EQ(decoded[i], i + 1);
   }
 }
+
+TEST_F(EliasGammaEncoderTest, WideCodesTest) {
+  // Values of every width, between runs of short codes, so that codes of
+  // every length start at many offsets within a block, and some do not fit
+  // in a 64-bit word
+  std::mt19937_64 gen(0);
+  std::vector<uint64_t> input;
+  for (uint64_t i = 0; i < kArraySize / 64; i++) {
+    uint8_t width = i % 64 + 1;
+    input.push_back((1ULL << (width - 1)) | (gen() & low_bits_set[width - 1]));
+    for (uint64_t j = 0; j < i % 7; j++) {
+      input.push_back(gen() % 4 + 1);
+    }
+  }
+  input.push_back(~0ULL);
+
+  auto encoded = bits::EliasGammaEncoder<uint64_t>::EncodeArray(input);
+  auto decoded = bits::EliasGammaEncoder<uint64_t>::DecodeArray(encoded);
+  ASSERT_EQ(decoded.size(), input.size());
+  for (uint64_t i = 0; i < input.size(); i++) {
+    ASSERT_EQ(decoded[i], input[i]);
+  }
+
+  uint64_t pos = 0;
+  for (uint64_t i = 0; i < input.size(); i++) {
+    ASSERT_EQ(bits::EliasGammaEncoder<uint64_t>::Decode(encoded, &pos), input[i]);
+  }
+  ASSERT_EQ(pos, encoded.GetSizeInBits());
+
+#ifdef BITS_X86
+  if (bits::CpuInfo::HasBMI2()) {
+    bits::BasicBitReader<bits::BMI2BitField> reader(encoded);
+    for (uint64_t i = 0; i < input.size(); i++) {
+      ASSERT_EQ(bits::EliasGammaEncoder<uint64_t>::Decode(reader), input[i]);
+    }
+    ASSERT_EQ(reader.GetPosition(), encoded.GetSizeInBits());
+  }
+#endif
+}
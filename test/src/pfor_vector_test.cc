@@ -0,0 +1,90 @@
+#include "pfor_vector.h"
+
+#include <cstdio>
+#include <fstream>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+class PForVectorTest : public testing::Test {
+ public:
+  const uint64_t kArraySize = (1024ULL * 1024ULL) + 77;  // Not a multiple of the block size
+
+ protected:
+  void SetUp() override {
+    // Locally narrow, globally wide values with occasional outliers
+    uint64_t x = 0x9E3779B97F4A7C15ULL;
+    for (uint64_t i = 0; i < kArraySize; i++) {
+      x ^= x << 13;
+      x ^= x >> 7;
+      x ^= x << 17;
+      uint64_t val = (1ULL << 40) + i * 1000 + (x % 256);
+      if (x % 97 == 0)
+        val += x % (1ULL << 30);
+      if (i / 128 == 5)
+        val = 42;  // A constant block
+      values.push_back(val);
+    }
+  }
+
+  std::vector<uint64_t> values;
+};
+
+TEST_F(PForVectorTest, GetTest) {
+  bits::PForVector<uint64_t> v(&values[0], values.size());
+  ASSERT_EQ(v.size(), kArraySize);
+  for (uint64_t i = 0; i < kArraySize; i++) {
+    ASSERT_EQ(v.Get(i), values[i]);
+  }
+}
+
+TEST_F(PForVectorTest, GetRangeTest) {
+  bits::PForVector<uint64_t> v(&values[0], values.size());
+
+  std::vector<uint64_t> out(kArraySize);
+  v.GetRange(0, kArraySize, &out[0]);
+  for (uint64_t i = 0; i < kArraySize; i++) {
+    ASSERT_EQ(out[i], values[i]);
+  }
+
+  v.GetRange(100, 1000, &out[0]);
+  for (uint64_t i = 0; i < 1000; i++) {
+    ASSERT_EQ(out[i], values[100 + i]);
+  }
+}
+
+TEST_F(PForVectorTest, NarrowTypeTest) {
+  std::vector<uint32_t> narrow(kArraySize);
+  for (uint64_t i = 0; i < kArraySize; i++) {
+    narrow[i] = (uint32_t) values[i];
+  }
+
+  bits::PForVector<uint32_t, 64> v(&narrow[0], narrow.size());
+  for (uint64_t i = 0; i < kArraySize; i++) {
+    ASSERT_EQ(v.Get(i), narrow[i]);
+  }
+}
+
+TEST_F(PForVectorTest, SerializeTest) {
+  bits::PForVector<uint64_t> v(&values[0], values.size());
+
+  std::string path = "pfor_vector_test.bin";
+  {
+    std::ofstream out(path, std::ios::binary);
+    v.Serialize(out);
+  }
+
+  bits::PForVector<uint64_t> deserialized;
+  {
+    std::ifstream in(path, std::ios::binary);
+    deserialized.Deserialize(in);
+  }
+
+  bits::PForVector<uint64_t> mapped;
+  ASSERT_NE(mapped.MemoryMap(path), 0U);
+  for (uint64_t i = 0; i < kArraySize; i++) {
+    ASSERT_EQ(deserialized.Get(i), values[i]);
+    ASSERT_EQ(mapped.Get(i), values[i]);
+  }
+  std::remove(path.c_str());
+}
@@ -0,0 +1,59 @@
+#include "radix_sort.h"
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+class RadixSortTest : public testing::Test {
+ public:
+  const uint64_t kArraySize = (1024ULL * 1024ULL);  // 1 KBytes
+
+  template<typename T, uint8_t W>
+  void CheckSort(uint64_t n, uint64_t num_threads, uint64_t seed) {
+    std::mt19937_64 gen(seed);
+    std::vector<T> values(n);
+    for (auto &val : values) {
+      val = (T) (gen() & low_bits_set[W]);
+    }
+
+    bits::CompactVector<T, W> v(n);
+    if (n != 0)
+      v.SetRange(0, n, &values[0]);
+    bits::RadixSort<T, W>::Sort(v, num_threads);
+
+    std::sort(values.begin(), values.end());
+    ASSERT_EQ(v.size(), n);
+    for (uint64_t i = 0; i < n; i++) {
+      ASSERT_EQ(v.Get(i), values[i]);
+    }
+  }
+};
+
+TEST_F(RadixSortTest, SingleThreadTest) {
+  CheckSort<uint64_t, 34>(kArraySize, 1, 0);
+  CheckSort<uint64_t, 64>(kArraySize, 1, 1);
+  CheckSort<uint32_t, 7>(kArraySize, 1, 2);
+  CheckSort<uint64_t, 34>(0, 1, 3);
+  CheckSort<uint64_t, 34>(1, 1, 4);
+  CheckSort<uint64_t, 34>(77, 1, 5);
+}
+
+TEST_F(RadixSortTest, MultiThreadTest) {
+  CheckSort<uint64_t, 34>(kArraySize + 13, 4, 6);
+  CheckSort<uint64_t, 20>(kArraySize, 3, 7);
+  CheckSort<uint32_t, 5>(kArraySize, 8, 8);
+}
+
+TEST_F(RadixSortTest, SkippedPassTest) {
+  // The high digits of all values are equal, so their passes are skipped
+  bits::CompactVector<uint64_t, 40> v(kArraySize);
+  for (uint64_t i = 0; i < kArraySize; i++) {
+    v.Set(i, (1ULL << 39) | ((i * 7919) % kArraySize));
+  }
+  bits::RadixSort<uint64_t, 40>::Sort(v, 2);
+  for (uint64_t i = 0; i < kArraySize; i++) {
+    ASSERT_EQ(v.Get(i), (1ULL << 39) | i);
+  }
+}